@@ -0,0 +1,46 @@
+#include "BlockTowerPhysics.h"
+
+/* Hooks for btAlignedAlloc, counting Bullet's heap traffic per thread and in total */
+
+// Counts for the calling thread - each world is stepped by a single thread, so a
+// difference taken around a step gives the allocations made by that step alone
+static thread_local AllocationCount threadCount = { 0, 0 };
+
+static std::atomic<unsigned long> totalAllocations(0);
+static std::atomic<unsigned long> totalBytes(0);
+
+
+static void* countedAlloc(size_t size)
+{
+	threadCount.allocations++;
+	threadCount.bytes += size;
+	totalAllocations++;
+	totalBytes += size;
+
+	return malloc(size);
+}
+
+
+static void countedFree(void* ptr)
+{
+	free(ptr);
+}
+
+
+void installAllocationHooks()
+{
+	/* Route Bullet's allocations through the counting functions, once per process */
+
+	static std::once_flag installed;
+	std::call_once(installed, []{ btAlignedAllocSetCustom(countedAlloc, countedFree); });
+}
+
+
+AllocationCount getThreadAllocations() { return threadCount; }
+
+
+AllocationCount getTotalAllocations()
+{
+	AllocationCount count = { totalAllocations, totalBytes };
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+// Count of heap allocations made through Bullet's allocator
+struct AllocationCount
+{
+	unsigned long allocations;
+	unsigned long bytes;
+};
+
+void installAllocationHooks();
+AllocationCount getThreadAllocations();
+AllocationCount getTotalAllocations();
\ No newline at end of file
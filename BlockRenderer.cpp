@@ -0,0 +1,363 @@
+#include "BlockTowerGame.h"
+
+#ifdef BT_USE_DOUBLE_PRECISION
+#define GL_SCALAR GL_DOUBLE		// GL type matching btScalar, for instance matrices
+#else
+#define GL_SCALAR GL_FLOAT
+#endif
+
+#define INSTANCE_ATTRIB 8	// First of four attribute locations holding the instance matrix
+
+static void multMatrix(const GLfloat* m) { glMultMatrixf(m); }
+static void multMatrix(const GLdouble* m) { glMultMatrixd(m); }
+
+// Places each vertex of a unit box by its instance matrix, and lights it as the fixed pipeline would
+static const char* vertexSource =
+	"#version 120\n"
+	"attribute mat4 instanceMatrix;\n"
+	"uniform vec3 extents;\n"
+	"uniform float lit;\n"
+	"varying vec4 colour;\n"
+	"void main() {\n"
+	"	vec4 world = instanceMatrix * vec4(gl_Vertex.xyz * extents, 1.0);\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * world;\n"
+	"	vec3 normal = normalize(gl_NormalMatrix * (mat3(instanceMatrix[0].xyz, instanceMatrix[1].xyz, instanceMatrix[2].xyz) * gl_Normal));\n"
+	"	float diffuse = max(dot(normal, normalize(gl_LightSource[0].position.xyz)), 0.0);\n"
+	"	vec3 light = gl_LightModel.ambient.rgb + gl_LightSource[0].diffuse.rgb * diffuse;\n"
+	"	colour = vec4(gl_Color.rgb * mix(vec3(1.0), light, lit), gl_Color.a);\n"
+	"}\n";
+
+static const char* fragmentSource =
+	"#version 120\n"
+	"varying vec4 colour;\n"
+	"void main() {\n"
+	"	gl_FragColor = colour;\n"
+	"}\n";
+
+
+BlockRenderer::BlockRenderer()
+{
+	boxBuffer = 0;
+	edgeBuffer = 0;
+	floorBuffer = 0;
+	instanceBuffer = 0;
+	floorVertexNo = 0;
+
+	instanceNo = 0;
+	instanceCapacity = 0;
+
+	instanced = false;
+	program = 0;
+	extentsLocation = -1;
+	litLocation = -1;
+
+	drawCalls = 0;
+}
+
+
+void BlockRenderer::initialize()
+{
+	/* Build static meshes and shader - requires a current GL context */
+
+	std::vector<MeshVertex> vertices;
+	MeshVertex vertex;
+
+	// Faces of the box, two triangles each, coloured in pairs like woodgrain
+	const GLfloat faceColours[3][3] = { {0.95,0.80,0.57}, {0.90,0.80,0.57}, {0.90,0.80,0.67} };
+	const int corners[6][2] = { {-1,-1}, {-1,1}, {1,-1}, {-1,1}, {1,-1}, {1,1} };
+	for ( int axis = 0; axis < 3; axis++ ) {
+		int u = ( axis == 0 ) ? 1 : 0;
+		int v = ( axis == 2 ) ? 1 : 2;
+		for ( int side = -1; side <= 1; side += 2 ) {
+			for ( int i = 0; i < 6; i++ ) {
+				vertex.position[axis] = side;
+				vertex.position[u] = corners[i][0];
+				vertex.position[v] = corners[i][1];
+				for ( int j = 0; j < 3; j++ ) {
+					vertex.normal[j] = ( j == axis ) ? side : 0;
+					vertex.colour[j] = faceColours[axis][j];
+				}
+				vertices.push_back(vertex);
+			}
+		}
+	}
+
+	glGenBuffers(1, &boxBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, boxBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+
+	// Edges of the box, four lines along each axis
+	vertices.clear();
+	for ( int axis = 0; axis < 3; axis++ ) {
+		int u = ( axis == 0 ) ? 1 : 0;
+		int v = ( axis == 2 ) ? 1 : 2;
+		for ( int i = 0; i < 4; i++ ) {
+			for ( int end = -1; end <= 1; end += 2 ) {
+				vertex.position[axis] = end;
+				vertex.position[u] = ( i & 1 ) ? 1 : -1;
+				vertex.position[v] = ( i & 2 ) ? 1 : -1;
+				for ( int j = 0; j < 3; j++ ) {
+					vertex.normal[j] = ( j == 1 ) ? 1 : 0;
+					vertex.colour[j] = 0;
+				}
+				vertices.push_back(vertex);
+			}
+		}
+	}
+
+	glGenBuffers(1, &edgeBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, edgeBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// Instancing needs per-attribute divisors and a shader to apply them
+	instanced = GLEW_VERSION_3_3;
+	if ( instanced )
+		compileProgram();
+
+	glEnable(GL_NORMALIZE);		// Blocks are scaled from a unit box, which would stretch their normals
+}
+
+
+void BlockRenderer::compileProgram()
+{
+	/* Compile and link the instancing shader, falling back to one draw per block if it fails */
+
+	const char* sources[2] = { vertexSource, fragmentSource };
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+
+	program = glCreateProgram();
+	for ( int i = 0; i < 2; i++ ) {
+		GLuint shader = glCreateShader(types[i]);
+		glShaderSource(shader, 1, &sources[i], NULL);
+		glCompileShader(shader);
+
+		GLint compiled = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+		if ( !compiled ) {
+			char log[512];
+			glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+			fprintf(stderr, "Block shader failed to compile, drawing without instancing:\n%s\n", log);
+			instanced = false;
+		}
+
+		glAttachShader(program, shader);
+		glDeleteShader(shader);		// Freed along with the program
+	}
+
+	glBindAttribLocation(program, INSTANCE_ATTRIB, "instanceMatrix");
+	glLinkProgram(program);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if ( !instanced || !linked ) {
+		instanced = false;
+		glDeleteProgram(program);
+		program = 0;
+		return;
+	}
+
+	extentsLocation = glGetUniformLocation(program, "extents");
+	litLocation = glGetUniformLocation(program, "lit");
+}
+
+
+void BlockRenderer::buildFloor(GLfloat surfaceHeight, GLfloat span, GLfloat farSpan)
+{
+	/* Build the static surface, sea and horizon planes once */
+
+	const GLfloat spans[3] = { 10, span, farSpan };
+	const GLfloat depths[3] = { 0, -0.1, -0.2 };
+	const GLfloat colours[3][3] = { {0.8,0.8,0.8}, {0,0.5,1}, {0,0.4,1} };
+	const int corners[6][2] = { {1,-1}, {1,1}, {-1,-1}, {1,1}, {-1,-1}, {-1,1} };
+
+	std::vector<MeshVertex> vertices;
+	MeshVertex vertex;
+	for ( int plane = 0; plane < 3; plane++ ) {
+		for ( int i = 0; i < 6; i++ ) {
+			vertex.position[0] = corners[i][0]*spans[plane];
+			vertex.position[1] = surfaceHeight+depths[plane];
+			vertex.position[2] = corners[i][1]*spans[plane];
+			for ( int j = 0; j < 3; j++ ) {
+				vertex.normal[j] = ( j == 1 ) ? 1 : 0;
+				vertex.colour[j] = colours[plane][j];
+			}
+			vertices.push_back(vertex);
+		}
+	}
+
+	if ( !floorBuffer )
+		glGenBuffers(1, &floorBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, floorBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	floorVertexNo = vertices.size();
+}
+
+
+void BlockRenderer::setInstances(const btTransform* trans, int number)
+{
+	/* Fill instance matrices from block transformations, without converting any rotations */
+
+	matrices.resize(number*16);
+	for ( int i = 0; i < number; i++ )
+		trans[i].getOpenGLMatrix(&matrices[i*16]);
+	instanceNo = number;
+
+	if ( !instanced )
+		return;		// Matrices are applied one draw at a time
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	if ( number > instanceCapacity ) {
+		glBufferData(GL_ARRAY_BUFFER, matrices.size()*sizeof(btScalar), matrices.data(), GL_STREAM_DRAW);
+		instanceCapacity = number;
+	}
+	else
+		glBufferSubData(GL_ARRAY_BUFFER, 0, matrices.size()*sizeof(btScalar), matrices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void BlockRenderer::bindMesh(GLuint buffer, boolean colours)
+{
+	/* Point the fixed vertex arrays at a mesh buffer */
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), (void*) offsetof(MeshVertex, position));
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, sizeof(MeshVertex), (void*) offsetof(MeshVertex, normal));
+	if ( colours ) {
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(3, GL_FLOAT, sizeof(MeshVertex), (void*) offsetof(MeshVertex, colour));
+	}
+	else
+		glDisableClientState(GL_COLOR_ARRAY);	// Use current colour
+}
+
+
+void BlockRenderer::drawInstances(GLuint buffer, GLenum mode, GLsizei vertexNo, const btVector3& extents, boolean colours, boolean lit)
+{
+	/* Draw a mesh once per block, scaled to extents */
+
+	if ( instanceNo == 0 )
+		return;
+
+	bindMesh(buffer, colours);
+
+	if ( instanced ) {
+		glUseProgram(program);
+		glUniform3f(extentsLocation, extents.getX(), extents.getY(), extents.getZ());
+		glUniform1f(litLocation, lit ? 1 : 0);
+
+		// Each column of the instance matrix advances once per block
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		for ( int i = 0; i < 4; i++ ) {
+			glEnableVertexAttribArray(INSTANCE_ATTRIB+i);
+			glVertexAttribPointer(INSTANCE_ATTRIB+i, 4, GL_SCALAR, GL_FALSE, 16*sizeof(btScalar), (void*) (i*4*sizeof(btScalar)));
+			glVertexAttribDivisor(INSTANCE_ATTRIB+i, 1);
+		}
+
+		glDrawArraysInstanced(mode, 0, vertexNo, instanceNo);
+		drawCalls++;
+
+		for ( int i = 0; i < 4; i++ )
+			glDisableVertexAttribArray(INSTANCE_ATTRIB+i);
+		glUseProgram(0);
+	}
+	else {
+		if ( !lit )
+			glDisable(GL_LIGHTING);
+		for ( int i = 0; i < instanceNo; i++ ) {
+			glPushMatrix();
+				multMatrix(&matrices[i*16]);
+				glScalef(extents.getX(), extents.getY(), extents.getZ());
+				glDrawArrays(mode, 0, vertexNo);
+			glPopMatrix();
+		}
+		drawCalls += instanceNo;
+		if ( !lit )
+			glEnable(GL_LIGHTING);
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void BlockRenderer::drawSingle(GLuint buffer, GLenum mode, GLsizei vertexNo, const btTransform& trans, const btVector3& extents)
+{
+	/* Draw a mesh for a single block in the current colour */
+
+	btScalar matrix[16];
+	trans.getOpenGLMatrix(matrix);
+
+	bindMesh(buffer, false);
+	glPushMatrix();
+		multMatrix(matrix);
+		glScalef(extents.getX(), extents.getY(), extents.getZ());
+		glDrawArrays(mode, 0, vertexNo);
+	glPopMatrix();
+	drawCalls++;
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void BlockRenderer::drawFloor()
+{
+	/* Draw the cached floor planes */
+
+	bindMesh(floorBuffer, true);
+	glDrawArrays(GL_TRIANGLES, 0, floorVertexNo);
+	drawCalls++;
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void BlockRenderer::drawBlocks(const btVector3& extents)
+{
+	drawInstances(boxBuffer, GL_TRIANGLES, 36, extents, true, true);
+}
+
+
+void BlockRenderer::drawEdges(const btVector3& extents)
+{
+	drawInstances(edgeBuffer, GL_LINES, 24, extents, false, false);
+}
+
+
+void BlockRenderer::drawBox(const btTransform& trans, const btVector3& extents)
+{
+	drawSingle(boxBuffer, GL_TRIANGLES, 36, trans, extents);
+}
+
+
+void BlockRenderer::drawLineBox(const btTransform& trans, const btVector3& extents)
+{
+	/* Draw box edges for a single block, unlit */
+
+	glDisable(GL_LIGHTING);
+	drawSingle(edgeBuffer, GL_LINES, 24, trans, extents);
+	glEnable(GL_LIGHTING);
+}
+
+
+boolean BlockRenderer::isInstanced() { return instanced; }
+
+int BlockRenderer::takeDrawCalls()
+{
+	int number = drawCalls;
+	drawCalls = 0;
+	return number;
+}
\ No newline at end of file
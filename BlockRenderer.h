@@ -0,0 +1,47 @@
+// Vertex layout shared by every static mesh
+struct MeshVertex {
+	GLfloat position[3];
+	GLfloat normal[3];
+	GLfloat colour[3];
+};
+
+class BlockRenderer
+{
+	GLuint boxBuffer;			// 36 triangle vertices of a box with unit half-extents
+	GLuint edgeBuffer;			// 24 line vertices of the same box
+	GLuint floorBuffer;			// Static floor planes, built once
+	GLuint instanceBuffer;		// One matrix per block, refilled each frame
+	int floorVertexNo;
+
+	std::vector<btScalar> matrices;		// Per-instance matrices, as given by btTransform::getOpenGLMatrix
+	int instanceNo;
+	int instanceCapacity;
+
+	boolean instanced;			// Whether instanced arrays and shaders are available
+	GLuint program;				// Shader applying the instance matrix, extents and lighting
+	GLint extentsLocation;
+	GLint litLocation;
+
+	int drawCalls;				// Draw calls issued since last counted
+
+	void compileProgram();
+	void bindMesh(GLuint buffer, boolean colours);
+	void drawInstances(GLuint buffer, GLenum mode, GLsizei vertexNo, const btVector3& extents, boolean colours, boolean lit);
+	void drawSingle(GLuint buffer, GLenum mode, GLsizei vertexNo, const btTransform& trans, const btVector3& extents);
+
+public:
+	BlockRenderer();
+
+	void initialize();
+	void buildFloor(GLfloat surfaceHeight, GLfloat span, GLfloat farSpan);
+	void setInstances(const btTransform* trans, int number);
+
+	void drawFloor();
+	void drawBlocks(const btVector3& extents);
+	void drawEdges(const btVector3& extents);
+	void drawBox(const btTransform& trans, const btVector3& extents);
+	void drawLineBox(const btTransform& trans, const btVector3& extents);
+
+	boolean isInstanced();
+	int takeDrawCalls();
+};
\ No newline at end of file
@@ -1,13 +1,29 @@
 #include <iostream>
+#ifdef _WIN32
 #include <windows.h>
+#else
+typedef unsigned char boolean;		// As windows.h defines it
+#endif
 #include <stdio.h>
-#include <cmath>
-#include <ctime>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/glew.h>				// GLEW, for buffer, shader and instancing entry points
+#ifdef _WIN32
+#include <GL/wglew.h>				// WGL extensions, for vsync
+#elif !defined(HEADLESS) && !defined(__APPLE__)
+#include <GL/glxew.h>				// GLX extensions, for vsync
+#endif
 #include <GL/gl.h>					// OpenGL (Open Graphics Library)
 #include <GL/glut.h>				// GLUT (GL Utility Kit)
-#include <btBulletDynamicsCommon.h>	// Bullet physics simulation library
+#ifdef HEADLESS
+#include <GL/osmesa.h>				// Off-screen Mesa, for rendering without a window
+#endif
+#include "BlockTowerTools.h"		// Game rules and physics, free of any windowing dependencies
 #include "Camera.h"
-#include "PhysicsWorld.h"
-
-#define PI 3.14159265				// Estimated value of pi, for converting angles
-#define BLOCK_NO 54					// Number of blocks in the tower
+#include "BlockRenderer.h"
+#include "FrameScheduler.h"
+#include "Overlay.h"
+#include "FrameProfiler.h"
+#ifdef HEADLESS
+#include "Headless.h"
+#endif
\ No newline at end of file
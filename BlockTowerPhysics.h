@@ -0,0 +1,44 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <btBulletDynamicsCommon.h>	// Bullet physics simulation library
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>		// Multithreaded pipeline
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <LinearMath/btQuickprof.h>		// Profile zone hooks
+#include "AllocationHooks.h"
+#include "ProfileHooks.h"
+#include "PhysicsThreads.h"
+#include "WorldArena.h"
+#include "TowerKernels.h"
+#include "WorldSnapshot.h"
+#include "ContactGraph.h"
+#include "SettleDetector.h"
+#include "InputLog.h"
+#include "PhysicsWorld.h"
+
+#define PI 3.14159265				// Estimated value of pi, for converting angles
+#define BLOCK_NO 54					// Default number of blocks in the tower
+#define LAYER_WIDTH 3				// Default number of blocks in each layer
+#define H_SPAN 60					// Horizontal spanning factor for play area
+#define BROADPHASE_DBVT 0			// Dynamic bounding volume trees
+#define BROADPHASE_SWEEP 1			// Sweep and prune over the bounded play area
+#define BROADPHASE_SIMPLE 2			// Every proxy against every other
+#define CONTACT_POOL_FACTOR 12		// Pooled contact manifolds and algorithms per block
+#define DISPATCH_GRAIN 40			// Overlapping pairs handed to each narrowphase task
+#define SAFE_LOAD 0.25				// Carried weight, in blocks, below which a block is deemed safe to remove
+#define SETTLE_SPEED 0.05			// Default peak block speed below which the tower counts as still
+#define SETTLE_ENERGY 0.002			// Default kinetic energy per block below which the tower counts as still
+#define SETTLE_WINDOW 0.05			// Default time, in seconds, the tower must stay still to be at rest
\ No newline at end of file
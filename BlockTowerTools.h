@@ -0,0 +1,9 @@
+#include "BlockTowerPhysics.h"		// Physics simulation layer
+#include "GameSession.h"
+#include "GameBot.h"
+#include "PhysicsThread.h"
+#include "TowerEnvApi.h"
+#include "WorkerPool.h"
+#include "TowerEnv.h"
+#include "TowerSolver.h"
+#include "StabilityPredictor.h"
\ No newline at end of file
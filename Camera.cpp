@@ -27,6 +27,9 @@ Camera::Camera(GLdouble initHeight, GLdouble initDistance, GLdouble initAngleX,
 	up[0] = 0;
 	up[1] = 1;
 	up[2] = 0;
+
+	updateModelview();
+	setPerspective(45, 1, 1, 1, 1000);	// Placeholder until the window size is known
 }
 
 
@@ -74,10 +77,90 @@ void Camera::updateView()
 		eye[1] = actualHeight+actualDistance*sin(actualAngleY*PI/180);
 		eye[2] = actualDistance*cos(actualAngleX*PI/180)*cos(actualAngleY*PI/180);
 		view[1] = actualHeight;
+		updateModelview();
 	}
 }
 
 
+boolean Camera::isMoving()
+{
+	/* Check whether actual attributes have yet to reach desired attributes */
+
+	return actualHeight != height || actualDistance != distance || actualAngleX != angleX || actualAngleY != angleY;
+}
+
+
+void Camera::updateModelview()
+{
+	/* Build the view matrix from eye, view and up, as gluLookAt would, without touching GL state */
+
+	GLdouble f[3] = { view[0]-eye[0], view[1]-eye[1], view[2]-eye[2] };
+	GLdouble length = sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+	for ( int i = 0; i < 3; i++ )
+		f[i] /= length;
+
+	// Side vector, forward x up
+	GLdouble s[3] = { f[1]*up[2]-f[2]*up[1], f[2]*up[0]-f[0]*up[2], f[0]*up[1]-f[1]*up[0] };
+	length = sqrt(s[0]*s[0] + s[1]*s[1] + s[2]*s[2]);
+	for ( int i = 0; i < 3; i++ )
+		s[i] /= length;
+
+	// Recomputed up vector, side x forward
+	GLdouble u[3] = { s[1]*f[2]-s[2]*f[1], s[2]*f[0]-s[0]*f[2], s[0]*f[1]-s[1]*f[0] };
+
+	// Column-major, as OpenGL expects
+	for ( int i = 0; i < 3; i++ ) {
+		modelview[i*4]   = s[i];
+		modelview[i*4+1] = u[i];
+		modelview[i*4+2] = -f[i];
+		modelview[i*4+3] = 0;
+	}
+	modelview[12] = -(s[0]*eye[0] + s[1]*eye[1] + s[2]*eye[2]);
+	modelview[13] = -(u[0]*eye[0] + u[1]*eye[1] + u[2]*eye[2]);
+	modelview[14] = f[0]*eye[0] + f[1]*eye[1] + f[2]*eye[2];
+	modelview[15] = 1;
+}
+
+
+void Camera::setPerspective(GLdouble fieldOfView, GLint width, GLint height, GLdouble zNear, GLdouble zFar)
+{
+	/* Build the projection matrix and viewport, as gluPerspective and glViewport would */
+
+	viewport[0] = 0;
+	viewport[1] = 0;
+	viewport[2] = width;
+	viewport[3] = height;
+
+	GLdouble aspect = (GLdouble) width / std::max(height,1);
+	GLdouble f = 1/tan(fieldOfView*PI/360);
+
+	for ( int i = 0; i < 16; i++ )
+		projection[i] = 0;
+	projection[0] = f/aspect;
+	projection[5] = f;
+	projection[10] = (zFar+zNear)/(zNear-zFar);
+	projection[11] = -1;
+	projection[14] = 2*zFar*zNear/(zNear-zFar);
+}
+
+
+void Camera::unproject(GLdouble winX, GLdouble winY, GLdouble winZ, GLdouble* point)
+{
+	/* Get world coordinates of a window position and depth, using the camera's own matrices */
+
+	gluUnProject(winX, winY, winZ, modelview, projection, viewport, &point[0], &point[1], &point[2]);
+}
+
+
+void Camera::getRay(int x, int y, GLdouble* rayFrom, GLdouble* rayTo)
+{
+	/* Get ray from the near to the far clipping plane through a window position, measured from the top left */
+
+	unproject(x, viewport[3]-y, 0, rayFrom);
+	unproject(x, viewport[3]-y, 1, rayTo);
+}
+
+
 void Camera::adjustHeight(GLdouble change, GLdouble lowBound, GLdouble upBound)
 {
 	/* Adjust desired height within given limits */
@@ -224,3 +307,7 @@ GLdouble Camera::getViewZ() { return view[2]; }
 GLdouble Camera::getUpX() { return up[0]; }
 GLdouble Camera::getUpY() { return up[1]; }
 GLdouble Camera::getUpZ() { return up[2]; }
+
+const GLdouble* Camera::getModelview() { return modelview; }
+const GLdouble* Camera::getProjection() { return projection; }
+const GLint* Camera::getViewport() { return viewport; }
@@ -16,10 +16,21 @@ class Camera
 	GLdouble* view;				// Point being viewed by camera
 	GLdouble* up;				// Up direction relative to camera
 
+	GLdouble modelview[16];		// View matrix, kept in step with eye/view/up
+	GLdouble projection[16];	// Perspective projection matrix
+	GLint viewport[4];			// Viewport the projection maps onto
+
+	void updateModelview();
+
 public:
 	Camera(GLdouble initHeight, GLdouble initDistance, GLdouble initAngleX, GLdouble initAngleY);
 
 	void updateView();
+	boolean isMoving();
+	void setPerspective(GLdouble fieldOfView, GLint width, GLint height, GLdouble zNear, GLdouble zFar);
+
+	void unproject(GLdouble winX, GLdouble winY, GLdouble winZ, GLdouble* point);
+	void getRay(int x, int y, GLdouble* rayFrom, GLdouble* rayTo);
 
 	void adjustHeight(GLdouble change, GLdouble min, GLdouble max);
 	void adjustDistance(GLdouble change, GLdouble min, GLdouble max);
@@ -63,4 +74,8 @@ public:
 	GLdouble getUpX();
 	GLdouble getUpY();
 	GLdouble getUpZ();
+
+	const GLdouble* getModelview();
+	const GLdouble* getProjection();
+	const GLint* getViewport();
 };
\ No newline at end of file
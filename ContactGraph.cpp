@@ -0,0 +1,122 @@
+#include "BlockTowerPhysics.h"
+
+ContactGraph::ContactGraph()
+{
+	blockNo = 0;
+	neighbourStart.assign(1, 0);
+}
+
+
+void ContactGraph::resize(int newBlockNo)
+{
+	/* Allocate per-block storage up front, and clear all contacts */
+
+	blockNo = newBlockNo;
+	groundContactNo.assign(blockNo, 0);
+	blockContactNo.assign(blockNo, 0);
+	groundSupport.assign(blockNo, 0);
+	load.assign(blockNo, 0);
+	neighbourStart.assign(blockNo+1, 0);
+	fillPosition.assign(blockNo, 0);
+	neighbours.clear();
+}
+
+
+btScalar ContactGraph::verticalForce(btPersistentManifold* contactManifold, btScalar timeStep)
+{
+	/* Get upward force on first body of manifold, from the solver's impulses in the last step */
+
+	// The contact normal points from the second body towards the first
+	btScalar impulse = 0;
+	for (int j=0; j<contactManifold->getNumContacts(); j++) {
+		const btManifoldPoint& point = contactManifold->getContactPoint(j);
+		impulse += point.m_appliedImpulse*point.m_normalWorldOnB.getY();
+	}
+
+	return impulse/timeStep;
+}
+
+
+void ContactGraph::build(btDispatcher* dispatcher, btScalar timeStep)
+{
+	/* Collect contacts from all manifolds in two passes - count, then fill */
+
+	// Blocks are identified by the user index of their body; the surface has index -1
+	int numManifolds = dispatcher->getNumManifolds();
+
+	std::fill(groundContactNo.begin(), groundContactNo.end(), 0);
+	std::fill(blockContactNo.begin(), blockContactNo.end(), 0);
+	std::fill(groundSupport.begin(), groundSupport.end(), 0);
+	std::fill(load.begin(), load.end(), 0);
+	std::fill(neighbourStart.begin(), neighbourStart.end(), 0);
+
+	// Count contacts, and neighbours of each block
+	for (int i=0; i<numManifolds; i++) {
+		btPersistentManifold* contactManifold = dispatcher->getManifoldByIndexInternal(i);
+		int contactNo = contactManifold->getNumContacts();
+		if ( contactNo == 0 )
+			continue;
+
+		int block0 = contactManifold->getBody0()->getUserIndex();
+		int block1 = contactManifold->getBody1()->getUserIndex();
+		if ( block0 < 0 && block1 >= 0 ) {
+			groundContactNo[block1] += contactNo;
+			groundSupport[block1] -= verticalForce(contactManifold, timeStep);
+		}
+		else if ( block1 < 0 && block0 >= 0 ) {
+			groundContactNo[block0] += contactNo;
+			groundSupport[block0] += verticalForce(contactManifold, timeStep);
+		}
+		else if ( block0 >= 0 && block1 >= 0 ) {
+			blockContactNo[block0] += contactNo;
+			blockContactNo[block1] += contactNo;
+			neighbourStart[block0+1]++;
+			neighbourStart[block1+1]++;
+		}
+	}
+
+	// Turn neighbour counts into starting positions
+	for (int i=0; i<blockNo; i++) {
+		neighbourStart[i+1] += neighbourStart[i];
+		fillPosition[i] = neighbourStart[i];
+	}
+	if ( int(neighbours.size()) < neighbourStart[blockNo] )
+		neighbours.resize(neighbourStart[blockNo]);
+
+	// Fill in neighbours of each block
+	for (int i=0; i<numManifolds; i++) {
+		btPersistentManifold* contactManifold = dispatcher->getManifoldByIndexInternal(i);
+		int contactNo = contactManifold->getNumContacts();
+		int block0 = contactManifold->getBody0()->getUserIndex();
+		int block1 = contactManifold->getBody1()->getUserIndex();
+		if ( contactNo == 0 || block0 < 0 || block1 < 0 )
+			continue;
+
+		btScalar force = verticalForce(contactManifold, timeStep);
+
+		ContactEdge& edge0 = neighbours[fillPosition[block0]++];
+		edge0.block = block1;
+		edge0.contactNo = contactNo;
+		edge0.support = force;
+		ContactEdge& edge1 = neighbours[fillPosition[block1]++];
+		edge1.block = block0;
+		edge1.contactNo = contactNo;
+		edge1.support = -force;
+
+		// Whichever block is underneath carries the one above
+		if ( force > 0 )
+			load[block1] += force;
+		else
+			load[block0] -= force;
+	}
+}
+
+
+bool ContactGraph::hasBlockContact(int block) { return blockContactNo[block] > 0; }
+bool ContactGraph::hasGroundContact(int block) { return groundContactNo[block] > 0; }
+int ContactGraph::getGroundContactNo(int block) { return groundContactNo[block]; }
+btScalar ContactGraph::getGroundSupport(int block) { return groundSupport[block]; }
+btScalar ContactGraph::getLoad(int block) { return load[block]; }
+const int* ContactGraph::getBlockContactCounts() { return blockContactNo.data(); }
+int ContactGraph::getNeighbourNo(int block) { return neighbourStart[block+1]-neighbourStart[block]; }
+const ContactEdge* ContactGraph::getNeighbours(int block) { return neighbours.data()+neighbourStart[block]; }
\ No newline at end of file
@@ -0,0 +1,48 @@
+// Block touching another block, with the number of contact points between them
+struct ContactEdge
+{
+	int block;
+	int contactNo;
+	btScalar support;	// Upward force received from the neighbour - positive if resting on it
+};
+
+// Single point of contact between two bodies, as found in the last step
+struct ContactPoint
+{
+	int body0;			// Block index of first body (-1 for surface)
+	int body1;			// Block index of second body (-1 for surface)
+	btVector3 position;	// Midway between the two bodies' surfaces
+	btVector3 normal;	// Points from the second body towards the first
+	btScalar force;		// Normal force pushing the first body away from the second
+	btScalar friction;	// Combined friction coefficient of the two surfaces
+};
+
+// Adjacency of blocks through contact points, and the forces between them,
+// rebuilt from the dispatcher's manifolds after each step
+class ContactGraph
+{
+	int blockNo;
+	std::vector<int> groundContactNo;		// Contact points between each block and the surface
+	std::vector<int> blockContactNo;		// Contact points between each block and all other blocks
+	std::vector<btScalar> groundSupport;	// Upward force on each block from the surface
+	std::vector<btScalar> load;				// Upward force each block exerts on blocks resting on it
+	std::vector<int> neighbourStart;		// Index of each block's first entry in neighbours (blockNo+1 entries)
+	std::vector<ContactEdge> neighbours;	// Neighbours of all blocks, grouped by block
+	std::vector<int> fillPosition;			// Next free entry in neighbours for each block, while building
+
+	btScalar verticalForce(btPersistentManifold* contactManifold, btScalar timeStep);
+
+public:
+	ContactGraph();
+	void resize(int newBlockNo);
+	void build(btDispatcher* dispatcher, btScalar timeStep);
+
+	bool hasBlockContact(int block);
+	bool hasGroundContact(int block);
+	int getGroundContactNo(int block);
+	btScalar getGroundSupport(int block);
+	btScalar getLoad(int block);
+	const int* getBlockContactCounts();
+	int getNeighbourNo(int block);
+	const ContactEdge* getNeighbours(int block);
+};
\ No newline at end of file
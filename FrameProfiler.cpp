@@ -0,0 +1,135 @@
+#include "BlockTowerGame.h"
+
+FrameProfiler::FrameProfiler()
+{
+	for ( int i = 0; i < STAGE_NO; i++ ) {
+		current[i] = 0;
+		for ( int j = 0; j < 3; j++ )
+			percentiles[i][j] = 0;
+	}
+	sampleNo = 0;
+	nextSample = 0;
+	frameNo = 0;
+	revision = 0;
+	lastSummary = std::chrono::steady_clock::now();
+	frameStart = lastSummary;
+	lastMark = lastSummary;
+	csv = 0;
+}
+
+
+FrameProfiler::~FrameProfiler()
+{
+	closeCsv();
+}
+
+
+bool FrameProfiler::openCsv(const char* path)
+{
+	/* Start streaming one row of stage times per frame to a file */
+
+	closeCsv();
+	csv = fopen(path, "w");
+	if ( !csv )
+		return false;
+
+	fprintf(csv, "frame");
+	for ( int i = 0; i < STAGE_NO; i++ )
+		fprintf(csv, ",%s_ms", getStageName(i));
+	fprintf(csv, "\n");
+	return true;
+}
+
+
+void FrameProfiler::closeCsv()
+{
+	if ( csv ) {
+		fclose(csv);
+		csv = 0;
+	}
+}
+
+
+void FrameProfiler::beginFrame()
+{
+	frameStart = std::chrono::steady_clock::now();
+	lastMark = frameStart;
+	for ( int i = 0; i < STAGE_NO; i++ )
+		current[i] = 0;
+}
+
+
+void FrameProfiler::mark(int stage)
+{
+	/* End a stage, adding the time since the previous mark to it */
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	current[stage] += std::chrono::duration<float, std::milli>(now-lastMark).count();
+	lastMark = now;
+}
+
+
+void FrameProfiler::setStage(int stage, float time)
+{
+	current[stage] = time;
+}
+
+
+void FrameProfiler::endFrame()
+{
+	/* Store the frame's stage times in the rolling window, and stream them if asked */
+
+	current[STAGE_TOTAL] = std::chrono::duration<float, std::milli>(lastMark-frameStart).count();
+
+	for ( int i = 0; i < STAGE_NO; i++ )
+		samples[i][nextSample] = current[i];
+	nextSample = (nextSample+1) % PROFILE_WINDOW;
+	sampleNo = std::min(sampleNo+1, PROFILE_WINDOW);
+
+	if ( csv ) {
+		fprintf(csv, "%lu", frameNo);
+		for ( int i = 0; i < STAGE_NO; i++ )
+			fprintf(csv, ",%.4f", current[i]);
+		fprintf(csv, "\n");
+	}
+	frameNo++;
+}
+
+
+bool FrameProfiler::summarize(double interval)
+{
+	/* Work out percentiles over the window, at most once per interval - returns whether they changed */
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if ( sampleNo == 0 || now-lastSummary < std::chrono::duration<double>(interval) )
+		return false;
+	lastSummary = now;
+
+	float sorted[PROFILE_WINDOW];
+	const float fractions[3] = { 0.50f, 0.95f, 0.99f };
+	for ( int i = 0; i < STAGE_NO; i++ ) {
+		std::copy(samples[i], samples[i]+sampleNo, sorted);
+		int lastRank = 0;
+		for ( int j = 0; j < 3; j++ ) {
+			// Each selection leaves everything above it to the right, so later ones search less
+			int rank = std::min(int(fractions[j]*sampleNo), sampleNo-1);
+			std::nth_element(sorted+lastRank, sorted+rank, sorted+sampleNo);
+			percentiles[i][j] = sorted[rank];
+			lastRank = rank;
+		}
+	}
+
+	revision++;
+	return true;
+}
+
+
+float FrameProfiler::getStage(int stage) { return current[stage]; }
+float FrameProfiler::getPercentile(int stage, int which) { return percentiles[stage][which]; }
+int FrameProfiler::getRevision() { return revision; }
+
+const char* FrameProfiler::getStageName(int stage)
+{
+	const char* names[STAGE_NO] = { "sync", "setup", "scene", "picking", "edges", "overlay", "logic", "swap", "physics", "total" };
+	return names[stage];
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+// Stages of a frame, in the order display() runs them
+#define STAGE_SYNC 0		// Taking the latest physics frame
+#define STAGE_SETUP 1		// Clearing, camera and drag-plane hits
+#define STAGE_SCENE 2		// Floor and blocks
+#define STAGE_PICKING 3		// Finding the block under the mouse
+#define STAGE_EDGES 4		// Block edges and highlight
+#define STAGE_OVERLAY 5		// HUD text and planes
+#define STAGE_LOGIC 6		// Game logic after drawing
+#define STAGE_SWAP 7		// Swapping buffers
+#define STAGE_PHYSICS 8		// Last tick on the physics thread, reported rather than timed here
+#define STAGE_TOTAL 9		// Whole frame on the render thread
+#define STAGE_NO 10
+
+#define PROFILE_WINDOW 256	// Frames kept for percentiles
+
+// Times each stage of a frame on the CPU. GL calls are queued, so a stage's time is what it took
+// to issue them, and any wait for the GPU shows up where the driver blocks - usually the swap.
+class FrameProfiler
+{
+	std::chrono::steady_clock::time_point frameStart;
+	std::chrono::steady_clock::time_point lastMark;
+	float current[STAGE_NO];				// Milliseconds for each stage of the frame being timed
+
+	float samples[STAGE_NO][PROFILE_WINDOW];	// Rolling window of past frames
+	int sampleNo;
+	int nextSample;
+	unsigned long frameNo;
+
+	float percentiles[STAGE_NO][3];		// p50, p95 and p99 as last worked out
+	std::chrono::steady_clock::time_point lastSummary;
+	int revision;						// Changes whenever the percentiles do
+
+	FILE* csv;
+
+public:
+	FrameProfiler();
+	~FrameProfiler();
+
+	bool openCsv(const char* path);
+	void closeCsv();
+
+	void beginFrame();
+	void mark(int stage);
+	void setStage(int stage, float time);
+	void endFrame();
+
+	bool summarize(double interval);
+	float getStage(int stage);
+	float getPercentile(int stage, int which);
+	int getRevision();
+	static const char* getStageName(int stage);
+};
\ No newline at end of file
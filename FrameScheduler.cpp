@@ -0,0 +1,150 @@
+#include "BlockTowerGame.h"
+
+#define INPUT_HOLD_FRAMES 10	// Frames drawn after input, long enough for the physics thread to answer a pick
+
+FrameScheduler::FrameScheduler()
+{
+	targetFps = 60;
+	dirtyOnly = true;
+	holdFrames = INPUT_HOLD_FRAMES;		// Draw the first frames regardless
+
+	nextFrame = std::chrono::steady_clock::now();
+
+	lastWall = nextFrame;
+	lastCpu = getProcessCpuTime();
+	cpuUsage = 0;
+
+	framesDrawn = 0;
+	framesSkipped = 0;
+}
+
+
+void FrameScheduler::setTargetFps(double fps)
+{
+	targetFps = std::max(fps, 0.0);
+}
+
+
+void FrameScheduler::setDirtyOnly(boolean on)
+{
+	dirtyOnly = on;
+}
+
+
+boolean FrameScheduler::requestVsync(boolean on)
+{
+	/* Ask the driver to wait for vertical blank on buffer swaps - returns false if it cannot */
+
+#ifdef _WIN32
+	if ( !WGLEW_EXT_swap_control )
+		return false;
+	return wglSwapIntervalEXT(on ? 1 : 0) != 0;
+#elif !defined(HEADLESS) && !defined(__APPLE__)
+	// Drivers offer one or more of these - SGI's cannot turn vsync off again
+	if ( GLXEW_EXT_swap_control ) {
+		glXSwapIntervalEXT(glXGetCurrentDisplay(), glXGetCurrentDrawable(), on ? 1 : 0);
+		return true;
+	}
+	if ( GLXEW_MESA_swap_control )
+		return glXSwapIntervalMESA(on ? 1 : 0) == 0;
+	if ( GLXEW_SGI_swap_control && on )
+		return glXSwapIntervalSGI(1) == 0;
+	return false;
+#else
+	(void)on;		// Off-screen and macOS builds have no swap interval to set
+	return false;
+#endif
+}
+
+
+void FrameScheduler::markDirty()
+{
+	/* Note input that may change what is on screen */
+
+	holdFrames = INPUT_HOLD_FRAMES;
+}
+
+
+boolean FrameScheduler::shouldDraw(boolean sceneChanging)
+{
+	/* Decide on each tick whether to draw a frame, keeping to the frame rate cap */
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if ( now < nextFrame )
+		return false;	// Woken early
+
+	if ( targetFps > 0 ) {
+		std::chrono::steady_clock::duration interval =
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1/targetFps));
+		nextFrame += interval;
+		if ( nextFrame < now )
+			nextFrame = now + interval;		// Fell behind - don't try to catch up
+	}
+
+	boolean draw = !dirtyOnly || sceneChanging || holdFrames > 0;
+	if ( holdFrames > 0 )
+		holdFrames--;
+
+	if ( draw )
+		framesDrawn++;
+	else
+		framesSkipped++;
+	return draw;
+}
+
+
+int FrameScheduler::getDelay()
+{
+	/* Get milliseconds until the next frame is due */
+
+	if ( targetFps <= 0 )
+		return 0;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if ( nextFrame <= now )
+		return 0;
+	return int(ceil(std::chrono::duration<double, std::milli>(nextFrame-now).count()));
+}
+
+
+double FrameScheduler::getProcessCpuTime()
+{
+	/* Get user and kernel time used by all threads of the process, in seconds */
+
+#ifdef _WIN32
+	FILETIME creation, exitTime, kernel, user;
+	if ( !GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user) )
+		return 0;
+
+	// FILETIME counts 100 ns intervals
+	double kernelTime = (double(kernel.dwHighDateTime)*4294967296.0 + kernel.dwLowDateTime) * 1e-7;
+	double userTime = (double(user.dwHighDateTime)*4294967296.0 + user.dwLowDateTime) * 1e-7;
+	return kernelTime + userTime;
+#else
+	return double(std::clock())/CLOCKS_PER_SEC;	// Process time on POSIX systems
+#endif
+}
+
+
+void FrameScheduler::measure()
+{
+	/* Update CPU usage and reset frame counts, as a percentage of one core */
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double cpu = getProcessCpuTime();
+	double wall = std::chrono::duration<double>(now-lastWall).count();
+	if ( wall > 0 )
+		cpuUsage = (cpu-lastCpu)/wall*100;
+
+	lastWall = now;
+	lastCpu = cpu;
+	framesDrawn = 0;
+	framesSkipped = 0;
+}
+
+
+double FrameScheduler::getTargetFps() { return targetFps; }
+boolean FrameScheduler::isDirtyOnly() { return dirtyOnly; }
+double FrameScheduler::getCpuUsage() { return cpuUsage; }
+int FrameScheduler::getFramesDrawn() { return framesDrawn; }
+int FrameScheduler::getFramesSkipped() { return framesSkipped; }
\ No newline at end of file
@@ -0,0 +1,36 @@
+class FrameScheduler
+{
+	double targetFps;		// Frame rate cap (0 for no cap)
+	boolean dirtyOnly;		// Whether to skip frames when nothing on screen would change
+	int holdFrames;			// Frames still to draw after the last input, for answers that lag behind it
+
+	std::chrono::steady_clock::time_point nextFrame;	// Earliest time the next frame may start
+
+	// CPU usage of the whole process since last measured
+	std::chrono::steady_clock::time_point lastWall;
+	double lastCpu;
+	double cpuUsage;
+
+	int framesDrawn;		// Frames drawn since last measured
+	int framesSkipped;		// Ticks that drew nothing since last measured
+
+	double getProcessCpuTime();
+
+public:
+	FrameScheduler();
+
+	void setTargetFps(double fps);
+	void setDirtyOnly(boolean on);
+	boolean requestVsync(boolean on);
+
+	void markDirty();
+	boolean shouldDraw(boolean sceneChanging);
+	int getDelay();
+
+	void measure();
+	double getTargetFps();
+	boolean isDirtyOnly();
+	double getCpuUsage();
+	int getFramesDrawn();
+	int getFramesSkipped();
+};
\ No newline at end of file
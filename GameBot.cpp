@@ -0,0 +1,134 @@
+#include "BlockTowerTools.h"
+
+GameBot::GameBot(PhysicsWorld* newWorld, int newStrategy, unsigned int seed) :
+	random(seed)
+{
+	world = newWorld;
+	strategy = newStrategy;
+	botIndex = -1;
+	botPlaced = false;
+}
+
+
+int GameBot::chooseBlock(const GameState& state, const btTransform* trans)
+{
+	/* Choose a block from below the top complete layer, by the bot's strategy */
+
+	int blockNo = world->getBlockNo();
+	int chosen = -1;
+
+	if ( strategy == BOT_SAFEST ) {
+		btScalar lowest = 0;
+		for ( int i=0; i<blockNo; i++ ) {
+			if ( trans[i].getOrigin().getY() >= state.towerHeight-2*LAYER_HEIGHT )
+				continue;
+			btScalar load = world->getLoad(i);
+			if ( chosen < 0 || load < lowest ) {
+				chosen = i;
+				lowest = load;
+			}
+		}
+		if ( chosen >= 0 )
+			return chosen;
+	}
+
+	for ( int i=0; i<blockNo; i++ ) {
+		chosen = random()%blockNo;
+		if ( trans[chosen].getOrigin().getY() < state.towerHeight-2*LAYER_HEIGHT )
+			break;
+	}
+
+	return chosen;
+}
+
+
+void GameBot::pointDown(GameInput& input, btScalar x, btScalar z)
+{
+	/* Point straight down at (x, z), as if from a camera high above the tower */
+
+	input.pointing = true;
+	input.rayFrom.setValue(x, 200, z);
+	input.rayTo.setValue(x, -200, z);
+}
+
+
+void GameBot::play(const GameState& state, const btTransform* trans, GameInput& input)
+{
+	/* Play turns the way a player would: choose a block from below the top, drag it out along
+	   its length, lift it, drop it on the middle of the top and ask for the placement to be checked */
+
+	input.events.clear();
+	input.pointing = false;
+	input.picked = false;
+	input.eye.setValue(0, 200, 0);
+
+	GameEvent key = { GAME_KEY, ' ' };
+	GameEvent press = { GAME_PRESS, 0 };
+	GameEvent release = { GAME_RELEASE, 0 };
+
+	switch ( state.phase ) {
+	case PHASE_CHOOSE:
+		botPlaced = false;
+		if ( state.objectIndex >= 0 && state.objectIndex == botIndex &&
+			trans[botIndex].getOrigin().getY() < state.towerHeight-LAYER_HEIGHT
+		) {
+			input.events.push_back(key);	// Choose the block picked last tick
+			break;
+		}
+		botIndex = chooseBlock(state, trans);
+		input.picked = true;
+		input.pickedIndex = botIndex;
+		input.pickedPoint = trans[botIndex].getOrigin();
+		break;
+	case PHASE_SELECT:
+		if ( botPlaced ) {
+			input.events.push_back(key);	// Check the placement
+			botPlaced = false;
+		}
+		else if ( !state.held ) {
+			// Take hold of the block, from its centre
+			input.picked = true;
+			input.pickedIndex = botIndex;
+			input.pickedPoint = trans[botIndex].getOrigin();
+			if ( state.targetIndex == botIndex )
+				input.events.push_back(press);
+		}
+		break;
+	case PHASE_REMOVE:
+		{
+			// Pull along the block's longest side, away from the middle of the tower
+			const btTransform& boxTrans = trans[state.objectIndex];
+			int longest = world->getBoxExtents().maxAxis();
+			btVector3 axis = boxTrans.getBasis().getColumn(longest);
+			axis.setY(0);
+			if ( axis.dot(boxTrans.getOrigin()) < 0 )
+				axis = -axis;
+			btVector3 target = boxTrans.getOrigin()+axis.normalized()*4;
+			pointDown(input, target.getX(), target.getZ());
+			if ( !world->checkContact(state.objectIndex) ) {
+				key.key = 'w';
+				input.events.push_back(key);	// Clear of the tower - lift it
+			}
+		}
+		break;
+	case PHASE_PLACE:
+		{
+			// Carry the block over the middle of the top, and let go once it is there
+			pointDown(input, 0, 0);
+			btVector3 origin = trans[state.objectIndex].getOrigin();
+			if ( btVector3(origin.getX(), 0, origin.getZ()).length() < 0.1 ) {
+				input.events.push_back(release);
+				botPlaced = true;
+			}
+		}
+		break;
+	case PHASE_COLLAPSE:
+		if ( state.held )
+			input.events.push_back(release);
+		else if ( state.messageTime == 0 )
+			input.events.push_back(key);	// Start a new game
+		break;
+	default:
+		break;
+	}
+}
\ No newline at end of file
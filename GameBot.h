@@ -0,0 +1,21 @@
+// Ways a bot chooses the block to take each turn
+#define BOT_RANDOM 0		// Any block below the top complete layer, at random
+#define BOT_SAFEST 1		// The block carrying the least weight from above
+
+// Plays a game session as a player would, through the same input a player gives - it points,
+// picks, presses and releases, rather than moving blocks itself, so it tests the game as played
+class GameBot
+{
+	PhysicsWorld* world;
+	int strategy;
+	std::minstd_rand random;
+	int botIndex;			// Block being played
+	bool botPlaced;			// Whether the block has been let go of over the tower
+
+	int chooseBlock(const GameState& state, const btTransform* trans);
+	void pointDown(GameInput& input, btScalar x, btScalar z);
+
+public:
+	GameBot(PhysicsWorld* newWorld, int newStrategy, unsigned int seed);
+	void play(const GameState& state, const btTransform* trans, GameInput& input);
+};
\ No newline at end of file
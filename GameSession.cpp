@@ -0,0 +1,375 @@
+#include "BlockTowerTools.h"
+
+GameInput::GameInput()
+{
+	pointing = false;
+	rayFrom.setValue(0,0,0);
+	rayTo.setValue(0,0,0);
+	eye.setValue(0,0,0);
+	cameraTurning = false;
+	picked = false;
+	pickedIndex = -1;
+	pickedPoint.setValue(0,0,0);
+}
+
+
+GameSession::GameSession()
+{
+	world = 0;
+	check.standing = true;
+	check.fallen = false;
+	check.active = false;
+
+	state.phase = PHASE_CHOOSE;
+	state.turnNo = 0;
+	state.maxTurnNo = 0;
+	state.score = 0;
+	state.towerHeight = 0;
+	state.objectIndex = -2;
+	state.targetIndex = -1;
+	state.held = false;
+	state.messageTime = 0;
+	state.gameNo = 0;
+	for ( int i=0; i<3; i++ ) {
+		state.cursor[i] = 0;
+		objectSelect[i] = 0;
+	}
+
+	removePlaneY = 0;
+	settled = false;
+	castValid = false;
+	castHit = false;
+	castIndex = -1;
+}
+
+
+void GameSession::start(PhysicsWorld* newWorld)
+{
+	/* Play on an already created world, starting a new game */
+
+	world = newWorld;
+	trans.assign(world->getBlockNo(), btTransform::getIdentity());
+	state.maxTurnNo = 0;
+	newGame();
+}
+
+
+void GameSession::newGame()
+{
+	/* Rebuild the tower and start again from the first turn, keeping the session's best */
+
+	world->resetWorld();
+	world->advanceWorld(0, trans.data());
+
+	setPhase(PHASE_CHOOSE);
+	state.turnNo = 0;
+	state.score = std::min(0, world->getBlockNo()-STANDARD_BLOCK_NO);
+	state.towerHeight = floor(double(world->getBlockNo())/world->getLayerWidth())*LAYER_HEIGHT;
+	state.targetIndex = -1;
+	state.gameNo++;
+	castValid = false;		// Blocks have moved under the pointer
+
+	check = world->checkTower(state.towerHeight-LAYER_HEIGHT, state.objectIndex);
+}
+
+
+void GameSession::setPhase(int newPhase, double newMessageTime)
+{
+	/* Set phase and any consistent settings related to it */
+
+	if ( newPhase != PHASE_CHECK )
+		world->cancelSettle();	// Only a placement check waits for the tower to settle
+
+	switch ( newPhase ) {
+	case PHASE_CHOOSE:
+		state.objectIndex = -2;
+		break;
+	case PHASE_REMOVE:
+		{
+			btVector3 boxOrigin = trans[state.objectIndex].getOrigin();
+			objectSelect[0] = state.cursor[0]-boxOrigin.getX();
+			objectSelect[1] = state.cursor[1]-boxOrigin.getY();
+			objectSelect[2] = state.cursor[2]-boxOrigin.getZ();
+		}
+		break;
+	case PHASE_RAISE:
+		objectSelect[1] = 0;
+		break;
+	case PHASE_PLACE:
+		removePlaneY = state.towerHeight+4;
+		objectSelect[0] = 0;
+		objectSelect[2] = 0;
+		break;
+	case PHASE_CHECK:
+		// Called from within a step, once the placed block and tower have stopped moving
+		settled = false;
+		world->watchSettle([this]() { settled = true; });
+		break;
+	default:
+		break;
+	}
+
+	state.phase = newPhase;
+	state.messageTime = newMessageTime;		// Set message time, or clear it
+}
+
+
+bool GameSession::canChoose()
+{
+	/* Check that the block under the pointer is below the top complete layer, so may be taken */
+
+	return state.phase == PHASE_CHOOSE && state.objectIndex >= 0 &&
+		trans[state.objectIndex].getOrigin().getY() < state.towerHeight-LAYER_HEIGHT;
+}
+
+
+bool GameSession::canPush()
+{
+	/* Check that the chosen block may be pushed or pulled from where the pointer is */
+
+	return canChoose() || ( state.phase == PHASE_SELECT && state.objectIndex == state.targetIndex );
+}
+
+
+void GameSession::applyEvent(const GameEvent& event, const GameInput& input)
+{
+	/* Apply a key press or button change */
+
+	int phase = state.phase;
+	int objectIndex = state.objectIndex;
+
+	if ( event.type == GAME_PRESS ) {
+		state.held = true;
+		// Select block
+		if ( phase == PHASE_SELECT && objectIndex == state.targetIndex && removePlaneY < input.eye.getY()-3 )
+			setPhase(PHASE_REMOVE);
+		return;
+	}
+
+	if ( event.type == GAME_RELEASE ) {
+		state.held = false;
+		// Release block
+		if ( phase == PHASE_REMOVE || phase == PHASE_RAISE || phase == PHASE_PLACE ) {
+			setPhase(PHASE_SELECT);
+			world->stopObject(objectIndex);
+		}
+		return;
+	}
+
+	switch ( event.key ) {
+	case ' ':
+		if ( canChoose() )
+			setPhase(PHASE_SELECT);		// Choose block
+		else if ( phase == PHASE_SELECT )
+			setPhase(PHASE_CHECK);		// Check a block placement
+		else if ( phase == PHASE_COLLAPSE && state.messageTime == 0 ) {
+			// Start a new game
+			if ( state.turnNo > state.maxTurnNo )
+				state.maxTurnNo = state.turnNo;
+			newGame();
+		}
+		break;
+	case 'w':	// W corresponds to up
+		if ( canPush() )
+			world->pushObject(objectIndex, -15, state.cursor);
+		else if ( phase == PHASE_REMOVE && !world->checkContact(objectIndex) )
+			setPhase(PHASE_RAISE);
+		else if ( phase == PHASE_PLACE && objectSelect[1] > -LAYER_HEIGHT )
+			objectSelect[1] -= LAYER_HEIGHT/2;	// Raise block
+		break;
+	case 's':	// S corresponds to down
+		if ( canPush() )
+			world->pushObject(objectIndex, 15, state.cursor);
+		else if ( phase == PHASE_PLACE && objectSelect[1] <= 3.24 )
+			objectSelect[1] += LAYER_HEIGHT/2;	// Lower block
+		break;
+	case 'a':	// A corresponds to left
+		if ( phase == PHASE_REMOVE || phase == PHASE_PLACE )
+			world->turnObject(objectIndex, 25);		// Rotate block anti-clockwise
+		break;
+	case 'd':	// D corresponds to right
+		if ( phase == PHASE_REMOVE || phase == PHASE_PLACE )
+			world->turnObject(objectIndex, -25);	// Rotate block clockwise
+		break;
+	default:
+		break;
+	}
+}
+
+
+void GameSession::pointHorizontal(const GameInput& input, double planeY, double span)
+{
+	/* Put the cursor where the pointer ray meets a horizontal plane, stopping at walls span from the centre in X and Z */
+
+	btVector3 rayFrom = input.rayFrom;
+	btVector3 dir = input.rayTo - rayFrom;
+
+	// Distance along the ray to the plane, or to the end of the ray if it never gets there
+	double t = 1;
+	if ( (planeY-rayFrom.getY())*dir.getY() > 0 )
+		t = std::min(t, (planeY-rayFrom.getY())/dir.getY());
+
+	// Stop where the ray leaves the play area, as it would have hit a wall first
+	for ( int i = 0; i < 3; i += 2 ) {
+		if ( dir[i] > 0 && rayFrom[i] < span )
+			t = std::min(t, (span-rayFrom[i])/dir[i]);
+		else if ( dir[i] < 0 && rayFrom[i] > -span )
+			t = std::min(t, (-span-rayFrom[i])/dir[i]);
+	}
+	t = std::max(t, 0.0);
+
+	state.cursor[0] = std::max(-span, std::min(span, rayFrom.getX() + dir.getX()*t));
+	state.cursor[1] = planeY;
+	state.cursor[2] = std::max(-span, std::min(span, rayFrom.getZ() + dir.getZ()*t));
+}
+
+
+void GameSession::pointVertical(const GameInput& input, const btVector3& origin)
+{
+	/* Put the cursor where the pointer ray meets a vertical plane through origin, facing the camera */
+
+	btVector3 dir = input.rayTo - input.rayFrom;
+
+	// Plane normal points horizontally from the tower's axis towards the eye
+	btVector3 normal(input.eye.getX(), 0, input.eye.getZ());
+	btScalar facing = normal.dot(dir);
+	if ( facing == 0 )
+		return;		// Ray runs along the plane - keep last cursor
+
+	btScalar t = normal.dot(origin-input.rayFrom) / facing;
+	if ( t < 0 )
+		return;		// Plane is behind the camera
+
+	btVector3 point = input.rayFrom + dir*t;
+	state.cursor[0] = point.getX();
+	state.cursor[1] = point.getY();
+	state.cursor[2] = point.getZ();
+}
+
+
+void GameSession::pick(const GameInput& input)
+{
+	/* Find the block under the pointer, and the point on it */
+
+	if ( input.picked ) {
+		// Picked by the caller
+		state.targetIndex = input.pickedIndex;
+		state.cursor[0] = input.pickedPoint.getX();
+		state.cursor[1] = input.pickedPoint.getY();
+		state.cursor[2] = input.pickedPoint.getZ();
+	}
+	else {
+		// Cast a new ray only when the pointer or camera has moved
+		if ( !castValid || input.rayFrom != castFrom || input.rayTo != castTo ) {
+			castHit = world->castRay(input.rayFrom, input.rayTo, castIndex, castPoint);
+			castFrom = input.rayFrom;
+			castTo = input.rayTo;
+			castValid = true;
+		}
+		if ( castHit ) {
+			state.cursor[0] = castPoint.getX();
+			state.cursor[1] = castPoint.getY();
+			state.cursor[2] = castPoint.getZ();
+		}
+		state.targetIndex = castIndex;
+	}
+
+	removePlaneY = state.cursor[1];		// Set plane for moving blocks
+	if ( state.phase == PHASE_CHOOSE )
+		state.objectIndex = state.targetIndex;
+}
+
+
+void GameSession::tick(double dt, const GameInput& input)
+{
+	/* Apply input, move any held block, advance the world by dt seconds and make the game's checks */
+
+	for ( size_t i=0; i<input.events.size(); i++ )
+		applyEvent(input.events[i], input);
+
+	/* If moving a block, get the cursor on the plane it moves on */
+
+	btVector3 boxOrigin = trans[std::max(0,state.objectIndex)].getOrigin();
+
+	if ( state.phase == PHASE_REMOVE ) {
+		if ( boxOrigin.getY() > state.towerHeight )
+			setPhase(PHASE_RAISE);
+		else if ( input.pointing )
+			pointHorizontal(input, removePlaneY, H_SPAN);	// Horizontal plane, walled at the play area
+	}
+
+	if ( state.phase == PHASE_RAISE ) {
+		if ( boxOrigin.getY() >= state.towerHeight+4 )
+			setPhase(PHASE_PLACE);
+		else if ( input.pointing )
+			pointVertical(input, boxOrigin);	// Vertical plane through the block
+	}
+
+	if ( state.phase == PHASE_PLACE && input.pointing )
+		pointHorizontal(input, removePlaneY, H_SPAN/2);	// Horizontal plane, walled above the tower
+
+	/* If not moving a block, find the one under the pointer */
+
+	if ( ( state.phase == PHASE_CHOOSE || state.phase == PHASE_SELECT ) && input.pointing && !state.held )
+		pick(input);
+
+	// Count down messages
+	if ( state.phase == PHASE_CHOOSE || state.phase == PHASE_SELECT || state.phase == PHASE_COLLAPSE )
+		state.messageTime = std::max(0.0, state.messageTime-dt);
+
+	/* If turning the view while placing, keep the selected block still */
+
+	if ( state.phase == PHASE_PLACE ) {
+		for ( int i = 0; i < 3; i += 2 ) {
+			double offset = state.cursor[i]-boxOrigin[i];
+			if ( input.cameraTurning ||
+				( objectSelect[i] > 0 && objectSelect[i] > offset ) ||
+				( objectSelect[i] < 0 && objectSelect[i] < offset )
+			)
+				objectSelect[i] = offset;
+		}
+	}
+
+	/* If currently moving block, affect physics world block appropriately */
+
+	if ( state.held ) {
+		if ( state.phase == PHASE_REMOVE || state.phase == PHASE_PLACE )
+			world->dragObject(state.objectIndex, state.cursor, objectSelect);	// Move block horizontally to cursor
+		else if ( state.phase == PHASE_RAISE )
+			world->raiseObjectTo(state.objectIndex, state.towerHeight+5.0);		// Raise block to top of tower
+	}
+
+	/* Step, then check the tower */
+
+	world->advanceWorld(btScalar(dt), trans.data());
+	check = world->checkTower(state.towerHeight-LAYER_HEIGHT, state.objectIndex);
+	if ( world->recenterBlocks(H_SPAN*1.1) > 0 )	// If blocks are out of play area, force them back
+		castValid = false;
+
+	// Check if tower has fallen in any minor way
+	if ( ( !check.standing || check.fallen ) && state.phase != PHASE_COLLAPSE )
+		setPhase(PHASE_COLLAPSE, COLLAPSE_TIME);
+
+	/* If block has been placed, try to validate placement once the tower is at rest */
+
+	if ( state.phase == PHASE_CHECK && settled ) {
+		double placedY = trans[state.objectIndex].getOrigin().getY();
+		if ( placedY < state.towerHeight-2*LAYER_HEIGHT )
+			setPhase(PHASE_SELECT, MESSAGE_TIME);	// Invalid - block is too low
+		else if ( placedY > state.towerHeight+LAYER_HEIGHT )
+			setPhase(PHASE_SELECT, MESSAGE_TIME);	// Invalid - block is too high
+		else {
+			// Valid - go onto next turn
+			setPhase(PHASE_CHOOSE, MESSAGE_TIME);
+			state.turnNo++;
+			state.score = std::min(state.turnNo, state.turnNo+world->getBlockNo()-STANDARD_BLOCK_NO);
+			if ( (state.turnNo+world->getBlockNo())%world->getLayerWidth() == 0 )
+				state.towerHeight += LAYER_HEIGHT;
+		}
+	}
+}
+
+
+const GameState& GameSession::getState() { return state; }
+const TowerCheck& GameSession::getCheck() { return check; }
+const btTransform* GameSession::getTransforms() { return trans.data(); }
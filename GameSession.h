@@ -0,0 +1,96 @@
+// Game phases
+#define PHASE_CHOOSE 0
+#define PHASE_SELECT 1
+#define PHASE_REMOVE 2
+#define PHASE_RAISE 3
+#define PHASE_PLACE 4
+#define PHASE_CHECK 5
+#define PHASE_COLLAPSE 6
+
+// Player input, as given to the game between ticks
+#define GAME_KEY 0			// Key pressed, one of space, w, s, a or d
+#define GAME_PRESS 1		// Left button pressed
+#define GAME_RELEASE 2		// Left button released
+
+#define MESSAGE_TIME 1.5	// Seconds a result message shows for after a placement check
+#define COLLAPSE_TIME 3.0	// Seconds after a collapse before a new game may be started
+#define LAYER_HEIGHT 1.52	// Height of a layer of blocks
+#define STANDARD_BLOCK_NO 54	// Tower size that scores are calibrated for
+
+struct GameEvent
+{
+	int type;		// GAME_KEY, GAME_PRESS or GAME_RELEASE
+	int key;		// ASCII key value, for GAME_KEY
+};
+
+// Input to a tick - events since the last tick, and where the player is pointing
+struct GameInput
+{
+	std::vector<GameEvent> events;
+	bool pointing;			// Whether the pointer is over the play area, so the ray below is valid
+	btVector3 rayFrom;		// Ray from the near to the far clipping plane through the pointer
+	btVector3 rayTo;
+	btVector3 eye;			// Camera position, which sets the plane a block is raised on
+	bool cameraTurning;		// Whether the view is swinging round, which keeps a block being placed still
+	bool picked;			// Whether the pick below replaces casting the ray, e.g. from a depth readback
+	int pickedIndex;		// Block under the pointer (-1 for none)
+	btVector3 pickedPoint;	// Point under the pointer
+
+	GameInput();
+};
+
+// State of a game after a tick, for drawing and for players to read
+struct GameState
+{
+	int phase;
+	int turnNo;				// Number of turns taken in the current game
+	int maxTurnNo;			// Highest number of turns taken in any game of the session
+	int score;				// Turns taken, less any made easier by a larger than standard tower
+	double towerHeight;		// Height of tower up to the highest complete layer
+	int objectIndex;		// Block chosen or being moved (-2 for none chosen yet)
+	int targetIndex;		// Block under the pointer (-1 for none)
+	bool held;				// Whether the left button is held
+	double messageTime;		// Seconds left for the current message, or before a new game may start
+	double cursor[3];		// Point the pointer is on, on the block or drag plane
+	unsigned long gameNo;	// Games started, so readers can tell when a new one begins
+};
+
+// Rules of the game, run against a physics world one tick at a time. Knows nothing of
+// windows or drawing - input arrives as events and a pointer ray, and the state after each
+// tick is there to be read, so the same game runs under a renderer, a bot or a test.
+class GameSession
+{
+	PhysicsWorld* world;
+	std::vector<btTransform> trans;		// Transformation of each block after the last tick
+	TowerCheck check;		// Tower checks made after the last tick
+	GameState state;
+
+	double objectSelect[3];	// Cursor relative to the block being moved
+	double removePlaneY;	// Height of horizontal plane for moving a selected block
+	bool settled;			// Whether the tower has come to rest since the placement check began
+
+	// Last ray cast, and what it hit, so a still pointer needs no new cast
+	btVector3 castFrom;
+	btVector3 castTo;
+	bool castValid;
+	bool castHit;
+	int castIndex;
+	btVector3 castPoint;
+
+	void setPhase(int newPhase, double newMessageTime=0);
+	void applyEvent(const GameEvent& event, const GameInput& input);
+	bool canChoose();
+	bool canPush();
+	void pointHorizontal(const GameInput& input, double planeY, double span);
+	void pointVertical(const GameInput& input, const btVector3& origin);
+	void pick(const GameInput& input);
+
+public:
+	GameSession();
+	void start(PhysicsWorld* newWorld);
+	void newGame();
+	void tick(double dt, const GameInput& input);
+	const GameState& getState();
+	const TowerCheck& getCheck();
+	const btTransform* getTransforms();
+};
\ No newline at end of file
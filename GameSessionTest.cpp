@@ -0,0 +1,54 @@
+#include "BlockTowerTools.h"
+
+/* Checks game session rules against a real physics world, run by ctest */
+
+int failureNo = 0;
+
+
+void check(bool condition, const char* description)
+{
+	/* Report a failed check, carrying on with the rest */
+
+	if ( !condition ) {
+		printf("FAILED: %s\n", description);
+		failureNo++;
+	}
+}
+
+
+int main()
+{
+	const int stepRate = 120;
+
+	PhysicsWorld world;
+	world.setStepRate(stepRate);
+	world.createWorld();
+
+	GameSession session;
+	GameInput input;
+	session.start(&world);
+	check(session.getState().phase == PHASE_CHOOSE, "a new game starts in PHASE_CHOOSE");
+	check(session.getCheck().standing, "a new tower is standing");
+
+	// A first tick a little short of a step runs no sub-step, which must not end the game
+	session.tick(0.9/stepRate, input);
+	check(session.getState().phase == PHASE_CHOOSE, "a short first tick stays in PHASE_CHOOSE");
+
+	for ( int tick = 0; tick < stepRate; tick++ )
+		session.tick(0.9/stepRate, input);
+	check(session.getState().phase == PHASE_CHOOSE, "a second of short ticks stays in PHASE_CHOOSE");
+
+	// The same after starting again, which restores the tower from its snapshot
+	unsigned long gameNo = session.getState().gameNo;
+	session.newGame();
+	check(session.getState().gameNo == gameNo+1, "starting again counts a new game");
+	session.tick(0.9/stepRate, input);
+	check(session.getState().phase == PHASE_CHOOSE, "a short first tick of a new game stays in PHASE_CHOOSE");
+
+	world.deleteWorld();
+
+	if ( failureNo > 0 )
+		return 1;
+	printf("Passed\n");
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "BlockTowerGame.h"
+
+#ifdef HEADLESS	// Only built for off-screen runs, which link against OSMesa
+
+HeadlessBackend::HeadlessBackend()
+{
+	context = 0;
+	width = 0;
+	height = 0;
+	useTimerQueries = true;
+	timerChecked = false;
+	timerQuery = 0;
+}
+
+
+HeadlessBackend::~HeadlessBackend()
+{
+	destroy();
+}
+
+
+bool HeadlessBackend::create(int newWidth, int newHeight)
+{
+	/* Create an off-screen context rendering into memory, and make it current */
+
+	destroy();
+	width = newWidth;
+	height = newHeight;
+	pixels.assign(width*height*4, 0);
+
+	context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, NULL);
+	if ( !context )
+		return false;
+	if ( !OSMesaMakeCurrent(context, pixels.data(), GL_UNSIGNED_BYTE, width, height) ) {
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+
+void HeadlessBackend::destroy()
+{
+	if ( timerQuery ) {
+		glDeleteQueries(1, &timerQuery);
+		timerQuery = 0;
+	}
+	timerChecked = false;	// A new context may differ
+	if ( context ) {
+		OSMesaDestroyContext(context);
+		context = 0;
+	}
+}
+
+
+bool HeadlessBackend::loadScript(const char* path, std::vector<ScriptEvent>& events)
+{
+	/* Read input events, one per line as "frame type values...", with # starting a comment */
+
+	FILE* file = fopen(path, "r");
+	if ( !file )
+		return false;
+
+	char line[256];
+	while ( fgets(line, sizeof(line), file) ) {
+		char* comment = strchr(line, '#');
+		if ( comment )
+			*comment = 0;
+
+		ScriptEvent event;
+		char type[16];
+		for ( int i = 0; i < 4; i++ )
+			event.values[i] = 0;
+		int fields = sscanf(line, "%d %15s %lf %lf %lf %lf", &event.frame, type,
+			&event.values[0], &event.values[1], &event.values[2], &event.values[3]);
+		if ( fields < 2 )
+			continue;	// Blank line
+
+		event.type = type;
+		if ( event.type == "key" ) {
+			// Keys are given as characters, except for space and escape
+			char key[16];
+			sscanf(line, "%*d %*s %15s", key);
+			if ( !strcmp(key, "space") )
+				event.values[0] = ' ';
+			else if ( !strcmp(key, "esc") )
+				event.values[0] = 27;
+			else
+				event.values[0] = key[0];
+		}
+		events.push_back(event);
+	}
+	fclose(file);
+
+	std::stable_sort(events.begin(), events.end(),
+		[](const ScriptEvent& a, const ScriptEvent& b) { return a.frame < b.frame; });
+	return true;
+}
+
+
+void HeadlessBackend::setTimerQueries(bool enable)
+{
+	/* Choose whether frames are timed on the GL side, before the first frame */
+
+	useTimerQueries = enable;
+}
+
+
+void HeadlessBackend::beginFrame()
+{
+	/* Start timing a frame on the GL side */
+
+	if ( !timerChecked ) {
+		if ( useTimerQueries && GLEW_ARB_timer_query )
+			glGenQueries(1, &timerQuery);
+		timerChecked = true;
+	}
+	if ( timerQuery )
+		glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+}
+
+
+void HeadlessBackend::endFrame(double cpuTime, double pickTime, double physicsTime)
+{
+	/* Finish a frame and record its CPU and GL times, and the picking and physics times it saw, in milliseconds */
+
+	if ( timerQuery )
+		glEndQuery(GL_TIME_ELAPSED);
+	glFinish();		// The software rasteriser does most of its work here
+
+	double glTime = -1;		// Unknown without timer queries
+	if ( timerQuery ) {
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsed);
+		glTime = elapsed*1e-6;
+	}
+
+	cpuTimes.push_back(cpuTime);
+	glTimes.push_back(glTime);
+	pickTimes.push_back(pickTime);
+	physicsTimes.push_back(physicsTime);
+}
+
+
+bool HeadlessBackend::saveFrame(const char* path)
+{
+	/* Write the last finished frame as a binary PPM, top row first */
+
+	FILE* file = fopen(path, "wb");
+	if ( !file )
+		return false;
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	std::vector<GLubyte> row(width*3);
+	for ( int y = height-1; y >= 0; y-- ) {
+		const GLubyte* source = &pixels[y*width*4];
+		for ( int x = 0; x < width; x++ ) {
+			row[x*3] = source[x*4];
+			row[x*3+1] = source[x*4+1];
+			row[x*3+2] = source[x*4+2];
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
+
+
+bool HeadlessBackend::saveTimings(const char* path)
+{
+	/* Write per-frame timings as CSV */
+
+	FILE* file = fopen(path, "w");
+	if ( !file )
+		return false;
+
+	fprintf(file, "frame,cpu_ms,gl_ms,pick_ms,physics_ms\n");
+	for ( size_t i = 0; i < cpuTimes.size(); i++ )
+		fprintf(file, "%d,%.4f,%.4f,%.4f,%.4f\n", int(i), cpuTimes[i], glTimes[i], pickTimes[i], physicsTimes[i]);
+	fclose(file);
+	return true;
+}
+
+
+bool HeadlessBackend::getGlSummary(double& mean, double& max)
+{
+	/* Get mean and worst GL frame times, over the frames timer queries measured - false if there were none */
+
+	double sum = 0;
+	int timedNo = 0;
+	max = 0;
+	for ( size_t i = 0; i < glTimes.size(); i++ ) {
+		if ( glTimes[i] < 0 )
+			continue;	// Not measured
+		sum += glTimes[i];
+		max = std::max(max, glTimes[i]);
+		timedNo++;
+	}
+	mean = timedNo > 0 ? sum/timedNo : 0;
+
+	return timedNo > 0;
+}
+
+
+void HeadlessBackend::printSummary()
+{
+	/* Print mean and worst frame times */
+
+	if ( cpuTimes.empty() )
+		return;
+
+	double cpuSum = 0, cpuMax = 0;
+	double pickSum = 0, pickMax = 0, physicsSum = 0, physicsMax = 0;
+	for ( size_t i = 0; i < cpuTimes.size(); i++ ) {
+		cpuSum += cpuTimes[i];
+		cpuMax = std::max(cpuMax, cpuTimes[i]);
+		pickSum += pickTimes[i];
+		pickMax = std::max(pickMax, pickTimes[i]);
+		physicsSum += physicsTimes[i];
+		physicsMax = std::max(physicsMax, physicsTimes[i]);
+	}
+
+	printf("%d frames at %dx%d\n", int(cpuTimes.size()), width, height);
+	printf("  cpu: mean %.3f ms, max %.3f ms\n", cpuSum/cpuTimes.size(), cpuMax);
+	double glMean, glMax;
+	if ( getGlSummary(glMean, glMax) )
+		printf("  gl:  mean %.3f ms, max %.3f ms\n", glMean, glMax);
+	else
+		printf("  gl:  timer queries not available\n");
+
+	// Readback picking stalls the render thread in the picking stage, where ray casts add to the physics tick
+	printf("  pick:    mean %.3f ms, max %.3f ms (render thread)\n", pickSum/pickTimes.size(), pickMax);
+	printf("  physics: mean %.3f ms, max %.3f ms (physics thread)\n", physicsSum/physicsTimes.size(), physicsMax);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+// One scripted input, applied before the frame it is due on
+struct ScriptEvent
+{
+	int frame;
+	std::string type;		// key, move, drag, press, release or camera
+	double values[4];
+};
+
+// Off-screen GL context on Mesa's software rasteriser, for rendering without a window or GPU.
+// Also reads the input script and records frame timings for a run.
+class HeadlessBackend
+{
+	OSMesaContext context;
+	std::vector<GLubyte> pixels;	// RGBA colour buffer rendered into, bottom row first
+	int width;
+	int height;
+
+	bool useTimerQueries;	// Whether to time frames on the GL side, where timer queries are available
+	bool timerChecked;		// Whether the context has been checked for timer queries
+	GLuint timerQuery;		// Measures GL time of a frame, if timer queries are available
+	std::vector<double> cpuTimes;
+	std::vector<double> glTimes;
+	std::vector<double> pickTimes;		// Picking stage on the render thread, which holds any depth readback
+	std::vector<double> physicsTimes;	// Last physics tick, which holds any pick ray cast
+
+public:
+	HeadlessBackend();
+	~HeadlessBackend();
+
+	bool create(int newWidth, int newHeight);
+	void destroy();
+
+	bool loadScript(const char* path, std::vector<ScriptEvent>& events);
+	void setTimerQueries(bool enable);
+
+	void beginFrame();
+	void endFrame(double cpuTime, double pickTime, double physicsTime);
+	bool saveFrame(const char* path);
+	bool saveTimings(const char* path);
+	bool getGlSummary(double& mean, double& max);
+	void printSummary();
+};
\ No newline at end of file
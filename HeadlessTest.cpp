@@ -0,0 +1,50 @@
+#include "BlockTowerGame.h"
+
+#ifdef HEADLESS	// Only built for off-screen runs, which link against OSMesa
+
+/* Checks the off-screen backend's frame timings, run by ctest in the headless build */
+
+int failureNo = 0;
+
+
+void check(bool condition, const char* description)
+{
+	/* Report a failed check, carrying on with the rest */
+
+	if ( !condition ) {
+		printf("FAILED: %s\n", description);
+		failureNo++;
+	}
+}
+
+
+int main()
+{
+	HeadlessBackend backend;
+	if ( !backend.create(64, 64) ) {
+		printf("SKIPPED: could not create an off-screen context\n");
+		return 77;
+	}
+
+	// Frames drawn without timer queries, as on a context that has none
+	backend.setTimerQueries(false);
+	for ( int frame = 0; frame < 3; frame++ ) {
+		backend.beginFrame();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		backend.endFrame(1.0, 0.25, 0.5);
+	}
+
+	double glMean = -1, glMax = -1;
+	check(!backend.getGlSummary(glMean, glMax), "no GL summary without timer queries");
+	check(glMean == 0 && glMax == 0, "unmeasured GL times are left out of the mean and max");
+	backend.printSummary();
+
+	backend.destroy();
+
+	if ( failureNo > 0 )
+		return 1;
+	printf("Passed\n");
+	return 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "BlockTowerPhysics.h"
+
+InputLog::InputLog()
+{
+	seed = 1;
+	blockNo = BLOCK_NO;
+	layerWidth = LAYER_WIDTH;
+	stepRate = 120;
+	maxSubSteps = 8;
+	threaded = false;
+	deterministic = true;
+}
+
+
+void InputLog::begin(unsigned int newSeed, int newBlockNo, int newLayerWidth, int newStepRate, int newMaxSubSteps,
+	bool newThreaded, bool newDeterministic)
+{
+	/* Start a new recording for a freshly built world */
+
+	seed = newSeed;
+	blockNo = newBlockNo;
+	layerWidth = newLayerWidth;
+	stepRate = newStepRate;
+	maxSubSteps = newMaxSubSteps;
+	threaded = newThreaded;
+	deterministic = newDeterministic;
+	events.clear();
+	finalTrans.clear();
+}
+
+
+void InputLog::add(unsigned long step, int type, int objectIndex, const double* values, int valueNo)
+{
+	/* Append a change to the world */
+
+	InputEvent event;
+	event.step = step;
+	event.type = type;
+	event.objectIndex = objectIndex;
+	for ( int i=0; i<6; i++ )
+		event.values[i] = i < valueNo ? values[i] : 0;
+	events.push_back(event);
+}
+
+
+void InputLog::end(const btTransform* trans, int transNo)
+{
+	/* Keep final block transformations, for checking a replay against */
+
+	finalTrans.assign(trans, trans+transNo);
+}
+
+
+int InputLog::getEventNo() { return int(events.size()); }
+
+
+bool InputLog::save(const char* path)
+{
+	/* Write recording to a text file - values are printed with enough digits to read back exactly */
+
+	FILE* file = fopen(path, "w");
+	if ( !file )
+		return false;
+
+	fprintf(file, "towerlog 1 seed %u blocks %d width %d rate %d substeps %d threaded %d deterministic %d\n",
+		seed, blockNo, layerWidth, stepRate, maxSubSteps, threaded ? 1 : 0, deterministic ? 1 : 0);
+
+	for ( size_t i=0; i<events.size(); i++ ) {
+		const InputEvent& event = events[i];
+		fprintf(file, "%lu %d %d", event.step, event.type, event.objectIndex);
+		for ( int j=0; j<6; j++ )
+			fprintf(file, " %.17g", event.values[j]);
+		fprintf(file, "\n");
+	}
+
+	fprintf(file, "end %d\n", int(finalTrans.size()));
+	for ( size_t i=0; i<finalTrans.size(); i++ ) {
+		// Origin and rotation matrix rows, as held by Bullet, so they compare exactly
+		const btVector3& origin = finalTrans[i].getOrigin();
+		const btMatrix3x3& basis = finalTrans[i].getBasis();
+		fprintf(file, "%.17g %.17g %.17g", double(origin.getX()), double(origin.getY()), double(origin.getZ()));
+		for ( int j=0; j<3; j++ )
+			fprintf(file, " %.17g %.17g %.17g", double(basis[j].getX()), double(basis[j].getY()), double(basis[j].getZ()));
+		fprintf(file, "\n");
+	}
+
+	return fclose(file) == 0;
+}
+
+
+bool InputLog::load(const char* path)
+{
+	/* Read a recording written by save */
+
+	FILE* file = fopen(path, "r");
+	if ( !file )
+		return false;
+
+	int version = 0;
+	int threadedFlag = 0;
+	int deterministicFlag = 1;
+	if ( fscanf(file, "towerlog %d seed %u blocks %d width %d rate %d substeps %d threaded %d deterministic %d",
+			&version, &seed, &blockNo, &layerWidth, &stepRate, &maxSubSteps, &threadedFlag, &deterministicFlag) != 8 ||
+		version != 1
+	) {
+		fclose(file);
+		return false;
+	}
+	threaded = threadedFlag != 0;
+	deterministic = deterministicFlag != 0;
+	events.clear();
+	finalTrans.clear();
+
+	// Events run until the line starting "end", which gives the number of final transformations
+	char word[32];
+	while ( fscanf(file, "%31s", word) == 1 && strcmp(word, "end") ) {
+		InputEvent event;
+		event.step = strtoul(word, 0, 10);
+		if ( fscanf(file, "%d %d %lf %lf %lf %lf %lf %lf", &event.type, &event.objectIndex,
+				&event.values[0], &event.values[1], &event.values[2],
+				&event.values[3], &event.values[4], &event.values[5]) != 8 ) {
+			fclose(file);
+			return false;
+		}
+		events.push_back(event);
+	}
+
+	int transNo = 0;
+	if ( fscanf(file, "%d", &transNo) == 1 ) {
+		for ( int i=0; i<transNo; i++ ) {
+			double v[12];
+			int read = 0;
+			for ( int j=0; j<12; j++ )
+				read += fscanf(file, "%lf", &v[j]);
+			if ( read != 12 )
+				break;
+			btTransform blockTrans;
+			blockTrans.setOrigin(btVector3(btScalar(v[0]), btScalar(v[1]), btScalar(v[2])));
+			blockTrans.getBasis().setValue(
+				btScalar(v[3]), btScalar(v[4]), btScalar(v[5]),
+				btScalar(v[6]), btScalar(v[7]), btScalar(v[8]),
+				btScalar(v[9]), btScalar(v[10]), btScalar(v[11]));
+			finalTrans.push_back(blockTrans);
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+
+ReplayResult InputLog::replay(PhysicsWorld& world)
+{
+	/* Reset the world with the recorded settings and re-apply every change as fast as possible,
+	   then compare the final blocks with the recording. The world is left built afterwards. */
+
+	world.setSeed(seed);
+	world.setTowerSize(blockNo, layerWidth);
+	world.setStepRate(stepRate);
+	world.setMaxSubSteps(maxSubSteps);
+	world.setThreading(threaded, deterministic);
+	// Start from a reset tower, as the recording did - resetting rebuilds a world of other settings
+	if ( !world.isBuilt() )
+		world.createWorld();
+	world.resetWorld();
+
+	std::vector<btTransform> trans(blockNo);
+	ReplayResult result = { true, true, 0, 0, 0 };
+
+	std::chrono::steady_clock::time_point replayStart = std::chrono::steady_clock::now();
+	for ( size_t i=0; i<events.size(); i++ ) {
+		const InputEvent& event = events[i];
+		if ( event.step != world.getStepCount() )
+			result.inStep = false;		// Already diverged - carry on, to see by how much
+
+		double* values = const_cast<double*>(event.values);
+		switch ( event.type ) {
+		case LOG_ADVANCE:
+			world.advanceWorld(btScalar(values[0]), trans.data());
+			break;
+		case LOG_PUSH:
+			world.pushObject(event.objectIndex, values[0], &values[1]);
+			break;
+		case LOG_TURN:
+			world.turnObject(event.objectIndex, values[0]);
+			break;
+		case LOG_DRAG:
+			world.dragObject(event.objectIndex, &values[0], &values[3]);
+			break;
+		case LOG_RAISE:
+			world.raiseObjectTo(event.objectIndex, values[0]);
+			break;
+		case LOG_STOP:
+			world.stopObject(event.objectIndex);
+			break;
+		case LOG_CENTER:
+			world.centerObject(event.objectIndex);
+			break;
+		case LOG_PLACE:
+			world.placeObject(event.objectIndex, btVector3(values[0], values[1], values[2]), values[3]);
+			break;
+		case LOG_RESET:
+			world.setSeed((unsigned int)values[0]);
+			world.resetWorld();
+			break;
+		default:
+			break;
+		}
+	}
+	result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-replayStart).count();
+	result.stepNo = world.getStepCount();
+
+	// Exact comparison - any difference at all means the replay has drifted
+	if ( int(finalTrans.size()) != blockNo )
+		result.match = false;
+	for ( int i=0; i<blockNo && i<int(finalTrans.size()); i++ ) {
+		const btTransform& blockTrans = world.getBlockTransform(i);
+		result.maxError = std::max(result.maxError, blockTrans.getOrigin().distance(finalTrans[i].getOrigin()));
+		if ( !( blockTrans.getOrigin() == finalTrans[i].getOrigin() && blockTrans.getBasis() == finalTrans[i].getBasis() ) )
+			result.match = false;
+	}
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+class PhysicsWorld;		// Replays drive a physics world, which in turn records into a log
+
+// Kinds of change made to a physics world, in the order they are recorded
+#define LOG_ADVANCE 0		// values[0] = time passed
+#define LOG_PUSH 1			// values[0] = impulse, values[1..3] = mouse ray
+#define LOG_TURN 2			// values[0] = impulse
+#define LOG_DRAG 3			// values[0..2] = mouse ray, values[3..5] = selection offset
+#define LOG_RAISE 4			// values[0] = height
+#define LOG_STOP 5
+#define LOG_CENTER 6
+#define LOG_RESET 7			// values[0] = seed the tower is rebuilt with
+#define LOG_PLACE 8			// values[0..2] = position, values[3] = turn about the vertical in degrees
+
+// Single change made to a physics world, tagged with the internal step it came before
+struct InputEvent
+{
+	unsigned long step;		// Internal steps simulated when the change was made
+	int type;
+	int objectIndex;
+	double values[6];
+};
+
+// Outcome of replaying a recorded session
+struct ReplayResult
+{
+	bool match;					// Whether every block ended exactly where it did when recorded
+	bool inStep;				// Whether every event came at the same step index as recorded
+	btScalar maxError;			// Largest distance between a replayed and a recorded final position
+	unsigned long stepNo;		// Internal steps simulated
+	double wallTime;			// Seconds taken, excluding building the world
+};
+
+// Everything needed to re-run a session on a physics world - its settings, each change
+// made to it and the final block transformations to check the re-run against
+class InputLog
+{
+	unsigned int seed;			// Seed the tower was first built with
+	int blockNo;
+	int layerWidth;
+	int stepRate;
+	int maxSubSteps;
+	bool threaded;				// Whether the world used the multithreaded pipeline
+	bool deterministic;			// Multithreaded worlds replay exactly only when deterministic
+	std::vector<InputEvent> events;
+	std::vector<btTransform> finalTrans;	// Block transformations when recording stopped
+
+public:
+	InputLog();
+	void begin(unsigned int newSeed, int newBlockNo, int newLayerWidth, int newStepRate, int newMaxSubSteps,
+		bool newThreaded, bool newDeterministic);
+	void add(unsigned long step, int type, int objectIndex, const double* values=0, int valueNo=0);
+	void end(const btTransform* trans, int transNo);
+	int getEventNo();
+	bool save(const char* path);
+	bool load(const char* path);
+	ReplayResult replay(PhysicsWorld& world);
+};
\ No newline at end of file
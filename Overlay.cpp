@@ -0,0 +1,241 @@
+#include "BlockTowerGame.h"
+
+Overlay::Overlay()
+{
+	atlas = 0;
+	buffer = 0;
+	atlasWidth = 512;
+	atlasHeight = 256;
+
+	for ( int font = 0; font < 2; font++ ) {
+		cellWidth[font] = 0;
+		cellHeight[font] = 0;
+		descent[font] = 0;
+	}
+	solid[0] = 0;
+	solid[1] = 0;
+
+	setColour(1,1,1);
+	vertexNo = 0;
+}
+
+
+void Overlay::initialize(int windowWidth, int windowHeight)
+{
+	/* Build the glyph atlas by drawing each glyph once and reading it back - requires a current GL context */
+
+	void* fonts[2] = { GLUT_BITMAP_HELVETICA_18, GLUT_BITMAP_HELVETICA_12 };
+	cellHeight[OVERLAY_FONT_LARGE] = 24;
+	descent[OVERLAY_FONT_LARGE] = 6;
+	cellHeight[OVERLAY_FONT_SMALL] = 16;
+	descent[OVERLAY_FONT_SMALL] = 4;
+
+	atlasWidth = std::min(atlasWidth, windowWidth);
+	atlasHeight = std::min(atlasHeight, windowHeight);
+
+	// Draw glyphs into the back buffer in window coordinates
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, windowWidth, 0, windowHeight, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glColor3f(1,1,1);
+
+	int x = 0;
+	int y = 0;
+	for ( int font = 0; font < 2; font++ ) {
+		cellWidth[font] = 0;
+		for ( int c = 32; c < 127; c++ )
+			cellWidth[font] = std::max(cellWidth[font], glutBitmapWidth(fonts[font], c)+2);
+
+		for ( int c = 32; c < 128; c++ ) {
+			if ( x+cellWidth[font] > atlasWidth ) {
+				x = 0;
+				y += cellHeight[font];
+			}
+
+			Glyph& glyph = glyphs[font][c-32];
+			glyph.u1 = GLfloat(x)/atlasWidth;
+			glyph.v1 = GLfloat(y)/atlasHeight;
+			glyph.u2 = GLfloat(x+cellWidth[font])/atlasWidth;
+			glyph.v2 = GLfloat(y+cellHeight[font])/atlasHeight;
+			glyph.advance = ( c < 127 ) ? glutBitmapWidth(fonts[font], c) : 0;
+
+			// One pixel of margin, so glyphs reaching left of their origin are kept
+			if ( c < 127 ) {
+				glRasterPos2i(x+1, y+descent[font]);
+				glutBitmapCharacter(fonts[font], c);
+			}
+			x += cellWidth[font];
+		}
+		x = 0;
+		y += cellHeight[font];
+	}
+
+	// Opaque texel below the glyphs, for drawing planes in the same batch
+	glRecti(0, y, 2, y+2);
+	solid[0] = 1.0f/atlasWidth;
+	solid[1] = (y+1.0f)/atlasHeight;
+
+	// Copy coverage into an alpha texture
+	std::vector<GLubyte> pixels(atlasWidth*atlasHeight);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, atlasWidth, atlasHeight, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+
+	glGenTextures(1, &atlas);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, atlasWidth, atlasHeight, 0, GL_ALPHA, GL_UNSIGNED_BYTE, pixels.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopAttrib();
+
+	glGenBuffers(1, &buffer);
+}
+
+
+void Overlay::begin()
+{
+	/* Start building a new overlay */
+
+	vertices.clear();
+	setColour(1,1,1);
+}
+
+
+void Overlay::setColour(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	colour[0] = r;
+	colour[1] = g;
+	colour[2] = b;
+	colour[3] = a;
+}
+
+
+void Overlay::addQuad(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2, GLfloat u1, GLfloat v1, GLfloat u2, GLfloat v2)
+{
+	/* Add a textured rectangle as two triangles */
+
+	const GLfloat corners[6][4] = {
+		{ x1, y1, u1, v1 }, { x2, y1, u2, v1 }, { x1, y2, u1, v2 },
+		{ x2, y1, u2, v1 }, { x2, y2, u2, v2 }, { x1, y2, u1, v2 }
+	};
+
+	OverlayVertex vertex;
+	for ( int j = 0; j < 4; j++ )
+		vertex.colour[j] = colour[j];
+	for ( int i = 0; i < 6; i++ ) {
+		vertex.position[0] = corners[i][0];
+		vertex.position[1] = corners[i][1];
+		vertex.texCoord[0] = corners[i][2];
+		vertex.texCoord[1] = corners[i][3];
+		vertices.push_back(vertex);
+	}
+}
+
+
+void Overlay::addText(const char* string, GLfloat x, GLfloat y, int font)
+{
+	/* Add a line of text with its baseline starting at (x, y), in window coordinates from the bottom left */
+
+	for ( ; *string; string++ ) {
+		unsigned char c = *string;
+		if ( c < 32 || c > 127 )
+			continue;
+
+		const Glyph& glyph = glyphs[font][c-32];
+		GLfloat left = x-1;
+		GLfloat bottom = y-descent[font];
+		if ( c != ' ' )
+			addQuad(left, bottom, left+cellWidth[font], bottom+cellHeight[font], glyph.u1, glyph.v1, glyph.u2, glyph.v2);
+		x += glyph.advance;
+	}
+}
+
+
+void Overlay::addPlane(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2)
+{
+	/* Add a flat rectangle, in window coordinates from the bottom left */
+
+	addQuad(x1, y1, x2, y2, solid[0], solid[1], solid[0], solid[1]);
+}
+
+
+void Overlay::end()
+{
+	/* Upload the overlay, to be drawn until the next rebuild */
+
+	vertexNo = vertices.size();
+	if ( !buffer )
+		return;		// Never initialized
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(OverlayVertex), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void Overlay::draw(int windowWidth, int windowHeight)
+{
+	/* Draw the overlay over the scene in one call, with a plain orthographic projection */
+
+	if ( vertexNo == 0 || !atlas )
+		return;		// Nothing to draw, or no fonts to draw it with
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, windowWidth, 0, windowHeight, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(OverlayVertex), (void*) offsetof(OverlayVertex, position));
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(OverlayVertex), (void*) offsetof(OverlayVertex, texCoord));
+	glEnableClientState(GL_COLOR_ARRAY);
+	glColorPointer(4, GL_FLOAT, sizeof(OverlayVertex), (void*) offsetof(OverlayVertex, colour));
+
+	glDrawArrays(GL_TRIANGLES, 0, vertexNo);
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDisable(GL_TEXTURE_2D);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#define OVERLAY_FONT_LARGE 0	// GLUT_BITMAP_HELVETICA_18
+#define OVERLAY_FONT_SMALL 1	// GLUT_BITMAP_HELVETICA_12
+
+// Vertex layout for overlay quads, in window coordinates
+struct OverlayVertex {
+	GLfloat position[2];
+	GLfloat texCoord[2];
+	GLfloat colour[4];
+};
+
+// Location of a glyph within the atlas
+struct Glyph {
+	GLfloat u1, v1, u2, v2;		// Texture coordinates of the cell
+	int advance;				// Pen movement after the glyph, in pixels
+};
+
+class Overlay
+{
+	GLuint atlas;				// Alpha texture holding every printable glyph of both fonts
+	GLuint buffer;				// Quads for the current overlay
+	int atlasWidth;
+	int atlasHeight;
+
+	Glyph glyphs[2][96];		// Printable characters 32-127 for each font
+	int cellWidth[2];
+	int cellHeight[2];
+	int descent[2];				// Cell height below the baseline
+	GLfloat solid[2];			// Texture coordinates of a fully opaque texel, for planes
+
+	std::vector<OverlayVertex> vertices;
+	GLfloat colour[4];			// Colour for quads added next
+	int vertexNo;				// Vertices uploaded to the buffer
+
+	void addQuad(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2, GLfloat u1, GLfloat v1, GLfloat u2, GLfloat v2);
+
+public:
+	Overlay();
+
+	void initialize(int windowWidth, int windowHeight);
+
+	void begin();
+	void setColour(GLfloat r, GLfloat g, GLfloat b, GLfloat a=1);
+	void addText(const char* string, GLfloat x, GLfloat y, int font=OVERLAY_FONT_LARGE);
+	void addPlane(GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2);
+	void end();
+
+	void draw(int windowWidth, int windowHeight);
+};
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include "BlockTowerTools.h"
+
+#define FRESH_FRAME 4		// Flag on the middle buffer index, set while it holds an unread frame
+
+
+PhysicsThread::PhysicsThread() : running(false), middle(1)
+{
+	world = 0;
+	tickRate = 120;
+	lockstep = false;
+	ticksRequested = 0;
+	ticksDone = 0;
+	back = 0;
+	front = 2;
+	standHeight = 0;
+	heldIndex = -1;
+	resetsPosted = 0;
+	resetsApplied = 0;
+	pickRequested = false;
+	lastPick.hit = false;
+	lastPick.objectIndex = -1;
+	lastPick.hitPoint = btVector3(0,0,0);
+	session = 0;
+}
+
+
+PhysicsThread::~PhysicsThread()
+{
+	stop();
+}
+
+
+void PhysicsThread::start(PhysicsWorld* newWorld, int newTickRate)
+{
+	/* Start stepping an already created world on its own thread */
+
+	stop();
+	world = newWorld;
+	if ( newTickRate > 0 )
+		tickRate = newTickRate;
+
+	for ( int i=0; i<3; i++ ) {
+		frames[i].trans.assign(world->getBlockNo(), btTransform::getIdentity());
+		frames[i].blockContact.assign(world->getBlockNo(), 0);
+		frames[i].check.standing = true;
+		frames[i].check.fallen = false;
+		frames[i].check.active = false;
+		frames[i].pick = lastPick;
+		frames[i].stepCount = 0;
+		frames[i].resetNo = resetsApplied;
+		frames[i].stepTime = 0;
+		frames[i].tickRate = 0;
+		if ( session )
+			frames[i].game = session->getState();
+	}
+
+	// Publish the world as it stands, so that readers have a frame before the first tick
+	if ( session ) {
+		std::copy(session->getTransforms(), session->getTransforms()+world->getBlockNo(), frames[back].trans.begin());
+		frames[back].check = session->getCheck();
+	}
+	else
+		world->advanceWorld(0, frames[back].trans.data());
+	frames[back].stepCount = world->getStepCount();
+	publish();
+
+	running = true;
+	thread = std::thread(&PhysicsThread::run, this);
+}
+
+
+void PhysicsThread::stop()
+{
+	/* Stop stepping, waiting for the current tick to finish - the world may then be used directly */
+
+	if ( running ) {
+		running = false;
+		{
+			std::lock_guard<std::mutex> lock(tickMutex);	// Wake a lockstep thread waiting for a tick
+		}
+		tickCondition.notify_all();
+		thread.join();
+	}
+}
+
+
+void PhysicsThread::setLockstep(bool on)
+{
+	/* Choose between ticking in real time and ticking only when asked - set before starting */
+
+	lockstep = on;
+}
+
+
+void PhysicsThread::setSession(GameSession* newSession)
+{
+	/* Tick a game session, already started on the world, instead of stepping the world - set before starting */
+
+	session = newSession;
+}
+
+
+void PhysicsThread::tick(int ticks)
+{
+	/* In lockstep, run a number of ticks of fixed length and wait for them to be published */
+
+	std::unique_lock<std::mutex> lock(tickMutex);
+	ticksRequested += ticks;
+	tickCondition.notify_all();
+	tickCondition.wait(lock, [this]() { return ticksDone >= ticksRequested || !running; });
+}
+
+
+void PhysicsThread::run()
+{
+	/* Step the world at the tick rate until stopped */
+
+	std::chrono::steady_clock::duration period =
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0/tickRate));
+	std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point rateStart = nextTick;
+	std::chrono::steady_clock::time_point lastTick = nextTick-period;
+	int rateTicks = 0;
+	float measuredRate = 0;
+	GameInput input;
+
+	while ( running ) {
+		if ( lockstep ) {
+			std::unique_lock<std::mutex> lock(tickMutex);
+			tickCondition.wait(lock, [this]() { return ticksDone < ticksRequested || !running; });
+			if ( !running )
+				break;
+		}
+
+		// Take the queued changes and check parameters together, then apply the changes at the step boundary
+		double checkHeight;
+		int checkIndex;
+		bool castPick;
+		btVector3 castFrom, castTo;
+		{
+			std::lock_guard<std::mutex> lock(commandMutex);
+			pendingCommands.swap(commands);
+			checkHeight = standHeight;
+			checkIndex = heldIndex;
+			castPick = pickRequested;
+			castFrom = pickFrom;
+			castTo = pickTo;
+			pickRequested = false;
+			if ( session ) {
+				input = sessionInput;
+				sessionInput.events.clear();	// The pointer stays until set again
+				sessionInput.picked = false;
+			}
+		}
+		for ( size_t i=0; i<pendingCommands.size(); i++ )
+			pendingCommands[i](*world);
+		pendingCommands.clear();
+
+		std::chrono::steady_clock::time_point tickStart = std::chrono::steady_clock::now();
+
+		// Step by the wall-clock time passed, then make the per-frame checks here rather than in the renderer
+		PhysicsFrame& frame = frames[back];
+		if ( session ) {
+			// Same result however long the tick takes in lockstep
+			double dt = lockstep ? 1.0/tickRate : std::chrono::duration<double>(tickStart-lastTick).count();
+			session->tick(dt, input);
+			std::copy(session->getTransforms(), session->getTransforms()+world->getBlockNo(), frame.trans.begin());
+			frame.check = session->getCheck();
+			frame.game = session->getState();
+		}
+		else {
+			if ( lockstep )
+				world->advanceWorld(btScalar(1.0)/tickRate, frame.trans.data());	// Same result however long the tick takes
+			else
+				world->stepWorld(frame.trans.data());
+			frame.check = world->checkTower(checkHeight, checkIndex);
+			world->recenterBlocks(H_SPAN*1.1);		// If blocks are out of play area, force them back
+		}
+		lastTick = tickStart;
+		for ( int i=0; i<world->getBlockNo(); i++ )
+			frame.blockContact[i] = world->checkContact(i) ? 1 : 0;
+		frame.stepCount = world->getStepCount();
+		frame.resetNo = resetsApplied;
+
+		// Only cast a new pick ray when asked, which readers do when the mouse or camera moves
+		if ( castPick )
+			lastPick.hit = world->castRay(castFrom, castTo, lastPick.objectIndex, lastPick.hitPoint);
+		frame.pick = lastPick;
+
+		std::chrono::steady_clock::time_point tickEnd = std::chrono::steady_clock::now();
+		frame.stepTime = std::chrono::duration<float, std::milli>(tickEnd-tickStart).count();
+
+		rateTicks++;
+		if ( tickEnd-rateStart >= std::chrono::seconds(1) ) {
+			measuredRate = rateTicks/std::chrono::duration<float>(tickEnd-rateStart).count();
+			rateTicks = 0;
+			rateStart = tickEnd;
+		}
+		frame.tickRate = measuredRate;
+
+		publish();
+
+		if ( lockstep ) {
+			{
+				std::lock_guard<std::mutex> lock(tickMutex);
+				ticksDone++;
+			}
+			tickCondition.notify_all();
+			continue;
+		}
+
+		// Keep to the tick rate, without trying to catch up after falling behind -
+		// stepWorld already takes the lost time, up to the sub-step limit
+		nextTick += period;
+		if ( nextTick < tickEnd )
+			nextTick = tickEnd;
+		std::this_thread::sleep_until(nextTick);
+	}
+}
+
+
+void PhysicsThread::publish()
+{
+	/* Swap the filled back buffer into the middle, for readers to take */
+
+	back = middle.exchange(back | FRESH_FRAME) & ~FRESH_FRAME;
+}
+
+
+const PhysicsFrame& PhysicsThread::acquireFrame()
+{
+	/* Get the latest published frame without waiting. It stays valid until the next call. */
+
+	if ( middle.load() & FRESH_FRAME )
+		front = middle.exchange(front) & ~FRESH_FRAME;
+	return frames[front];
+}
+
+
+bool PhysicsThread::isCurrent(const PhysicsFrame& frame)
+{
+	/* Check that a frame was stepped after every reset queued so far */
+
+	return frame.resetNo == resetsPosted;
+}
+
+
+void PhysicsThread::post(const std::function<void(PhysicsWorld&)>& command)
+{
+	/* Queue a change to the world, applied before the next step */
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	commands.push_back(command);
+}
+
+
+void PhysicsThread::setTowerCheck(double newStandHeight, int newHeldIndex)
+{
+	/* Set height above which blocks show the tower standing, and the block being held (-1 for none) */
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	standHeight = newStandHeight;
+	heldIndex = newHeldIndex;
+}
+
+
+void PhysicsThread::pick(const btVector3& rayFrom, const btVector3& rayTo)
+{
+	/* Ask for a ray to be cast into the world after the next step, replacing any ray not yet cast */
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	pickFrom = rayFrom;
+	pickTo = rayTo;
+	pickRequested = true;
+}
+
+
+void PhysicsThread::resetWorld()
+{
+	resetsPosted++;
+	post([this](PhysicsWorld& world) {
+		world.resetWorld();
+		resetsApplied++;
+	});
+}
+
+
+void PhysicsThread::watchSettle(const std::function<void()>& callback)
+{
+	// The callback is made on the physics thread
+	post([callback](PhysicsWorld& world) { world.watchSettle(callback); });
+}
+
+
+void PhysicsThread::cancelSettle()
+{
+	post([](PhysicsWorld& world) { world.cancelSettle(); });
+}
+
+
+void PhysicsThread::pushObject(int objectIndex, double impulse, const double* mouseRay)
+{
+	double x = mouseRay[0], y = mouseRay[1], z = mouseRay[2];
+	post([=](PhysicsWorld& world) {
+		double ray[3] = { x, y, z };
+		world.pushObject(objectIndex, impulse, ray);
+	});
+}
+
+
+void PhysicsThread::turnObject(int objectIndex, double impulse)
+{
+	post([=](PhysicsWorld& world) { world.turnObject(objectIndex, impulse); });
+}
+
+
+void PhysicsThread::dragObject(int objectIndex, const double* mouseRay, const double* objectSelect)
+{
+	double x = mouseRay[0], y = mouseRay[1], z = mouseRay[2];
+	double selectX = objectSelect[0], selectY = objectSelect[1], selectZ = objectSelect[2];
+	post([=](PhysicsWorld& world) {
+		double ray[3] = { x, y, z };
+		double select[3] = { selectX, selectY, selectZ };
+		world.dragObject(objectIndex, ray, select);
+	});
+}
+
+
+void PhysicsThread::raiseObjectTo(int objectIndex, double height)
+{
+	post([=](PhysicsWorld& world) { world.raiseObjectTo(objectIndex, height); });
+}
+
+
+void PhysicsThread::stopObject(int objectIndex)
+{
+	post([=](PhysicsWorld& world) { world.stopObject(objectIndex); });
+}
+
+
+void PhysicsThread::postGameEvent(int type, int key)
+{
+	/* Queue a key press or button change for the session's next tick */
+
+	GameEvent event = { type, key };
+	std::lock_guard<std::mutex> lock(commandMutex);
+	sessionInput.events.push_back(event);
+}
+
+
+void PhysicsThread::setPointer(bool pointing, const btVector3& rayFrom, const btVector3& rayTo, const btVector3& eye, bool cameraTurning)
+{
+	/* Set where the player is pointing, kept for every tick until set again */
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	sessionInput.pointing = pointing;
+	sessionInput.rayFrom = rayFrom;
+	sessionInput.rayTo = rayTo;
+	sessionInput.eye = eye;
+	sessionInput.cameraTurning = cameraTurning;
+}
+
+
+void PhysicsThread::setPicked(int objectIndex, const btVector3& point)
+{
+	/* Give the block under the pointer for the next tick, instead of the session casting the pointer ray */
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	sessionInput.picked = true;
+	sessionInput.pickedIndex = objectIndex;
+	sessionInput.pickedPoint = point;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+// Result of casting the latest pick ray into the world
+struct PickResult
+{
+	bool hit;				// Whether the ray hit a block or the surface
+	int objectIndex;		// Block hit (-1 for surface or nothing)
+	btVector3 hitPoint;		// First point along the ray on the block or surface
+};
+
+// State of the physics world published after a step, for reading on other threads
+struct PhysicsFrame
+{
+	std::vector<btTransform> trans;				// Interpolated transformation of each block
+	std::vector<unsigned char> blockContact;	// 1 for each block touching another block
+	TowerCheck check;			// Tower checks made straight after the step
+	GameState game;				// State of the game after the tick, when running a session
+	PickResult pick;			// What the latest pick ray hit, as of the step it was cast after
+	unsigned long stepCount;	// Internal steps simulated
+	unsigned long resetNo;		// Resets applied before the step
+	float stepTime;				// Milliseconds spent on the last physics tick
+	float tickRate;				// Physics ticks per second, measured over the last second
+};
+
+// Runs a physics world on its own thread at a fixed rate. Transformations are published
+// through a triple buffer, so readers never wait for a step, and changes to the world are
+// queued up to be applied between steps. Given a game session, the thread ticks the game
+// instead of stepping the world directly, and input is queued for the session's next tick.
+class PhysicsThread
+{
+	PhysicsWorld* world;
+	int tickRate;				// Ticks per second the thread aims for
+	std::thread thread;
+	std::atomic<bool> running;
+
+	// In lockstep, the thread only ticks when asked, by a fixed time per tick
+	bool lockstep;
+	std::mutex tickMutex;
+	std::condition_variable tickCondition;
+	unsigned long ticksRequested;
+	unsigned long ticksDone;
+
+	// Triple buffer - the thread fills back, readers hold front, and the two swap through middle
+	PhysicsFrame frames[3];
+	int back;
+	int front;
+	std::atomic<int> middle;	// Index of middle buffer, with FRESH_FRAME set if it holds a newer frame than front
+
+	// Changes waiting for the next step boundary, and parameters for the tower checks
+	std::mutex commandMutex;
+	std::vector<std::function<void(PhysicsWorld&)> > commands;
+	std::vector<std::function<void(PhysicsWorld&)> > pendingCommands;	// Only touched by the thread
+	double standHeight;
+	int heldIndex;
+	unsigned long resetsPosted;		// Resets queued so far, counted on the posting side
+	unsigned long resetsApplied;	// Resets applied so far, counted on the thread
+
+	// Ray to cast after the next step, and the result kept for publishing with every frame
+	btVector3 pickFrom;
+	btVector3 pickTo;
+	bool pickRequested;
+	PickResult lastPick;
+
+	// Game played on the world, if any, and the input gathered for its next tick
+	GameSession* session;
+	GameInput sessionInput;
+
+	void run();
+	void publish();
+
+public:
+	PhysicsThread();
+	~PhysicsThread();
+	void start(PhysicsWorld* newWorld, int newTickRate);
+	void stop();
+	void setLockstep(bool on);
+	void setSession(GameSession* newSession);
+	void tick(int ticks);
+	const PhysicsFrame& acquireFrame();
+	bool isCurrent(const PhysicsFrame& frame);
+
+	void post(const std::function<void(PhysicsWorld&)>& command);
+	void setTowerCheck(double newStandHeight, int newHeldIndex);
+	void pick(const btVector3& rayFrom, const btVector3& rayTo);
+	void resetWorld();
+	void watchSettle(const std::function<void()>& callback);
+	void cancelSettle();
+	void pushObject(int objectIndex, double impulse, const double* mouseRay);
+	void turnObject(int objectIndex, double impulse);
+	void dragObject(int objectIndex, const double* mouseRay, const double* objectSelect);
+	void raiseObjectTo(int objectIndex, double height);
+	void stopObject(int objectIndex);
+
+	void postGameEvent(int type, int key);
+	void setPointer(bool pointing, const btVector3& rayFrom, const btVector3& rayTo, const btVector3& eye, bool cameraTurning);
+	void setPicked(int objectIndex, const btVector3& point);
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "BlockTowerPhysics.h"
+
+static std::once_flag schedulerOnce;
+static btITaskScheduler* scheduler = 0;	// Scheduler handed to Bullet, created on first use
+
+
+static void createScheduler()
+{
+	/* Pick the best task scheduler Bullet was built with, falling back to running tasks in turn */
+
+	scheduler = btCreateDefaultTaskScheduler();
+	if ( !scheduler )
+		scheduler = btGetOpenMPTaskScheduler();
+	if ( !scheduler )
+		scheduler = btGetTBBTaskScheduler();
+	if ( !scheduler )
+		scheduler = btGetPPLTaskScheduler();
+	if ( !scheduler )
+		scheduler = btGetSequentialTaskScheduler();
+
+	btSetTaskScheduler(scheduler);
+}
+
+
+bool setPhysicsThreads(int threadNo)
+{
+	/* Set number of threads used by multithreaded worlds (0 for all cores) - false if Bullet lacks thread support */
+
+#if BT_THREADSAFE
+	std::call_once(schedulerOnce, createScheduler);
+
+	if ( threadNo <= 0 )
+		threadNo = int(std::max(1u, std::thread::hardware_concurrency()));
+	scheduler->setNumThreads(std::min(threadNo, scheduler->getMaxNumThreads()));
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+int getPhysicsThreads()
+{
+	/* Get number of threads multithreaded worlds will use */
+
+#if BT_THREADSAFE
+	if ( scheduler )
+		return scheduler->getNumThreads();
+#endif
+	return 1;
+}
\ No newline at end of file
@@ -0,0 +1,4 @@
+// Task scheduler shared by every multithreaded physics world in the process.
+// Bullet keeps a single global scheduler, so the thread count is process-wide.
+bool setPhysicsThreads(int threadNo);
+int getPhysicsThreads();
\ No newline at end of file
@@ -1,15 +1,129 @@
-#include "BlockTowerGame.h"
+#include "BlockTowerPhysics.h"
+
+PhysicsWorld::PhysicsWorld() : arena(64*1024)
+{
+	installAllocationHooks();	// Count Bullet's own heap allocations
+	installProfileHooks();		// Time the broadphase within each step
+
+	// Default stepping settings, kept across world resets
+	fixedTimeStep = btScalar(1.0/120.0);
+	maxSubSteps = 8;
+	timerStarted = false;
+	droppedSubSteps = 0;
+	stepCount = 0;
+	seed = 1;
+	stepAllocations.allocations = 0;
+	stepAllocations.bytes = 0;
+	stepBroadphaseTime = 0;
+
+	// Default tower size
+	blockNo = 0;
+	layerWidth = 0;
+	nextBlockNo = BLOCK_NO;
+	nextLayerWidth = LAYER_WIDTH;
+
+	broadphaseType = BROADPHASE_DBVT;
+	nextBroadphaseType = BROADPHASE_DBVT;
+	dynamicsWorld = 0;		// Not built until createWorld
+
+	// Single-threaded unless asked otherwise
+	threaded = false;
+	deterministic = true;
+	nextThreaded = false;
+	nextDeterministic = true;
+
+	recorder = 0;
+
+	// Default limits for the tower to count as at rest
+	settleWindow = btScalar(SETTLE_WINDOW);
+	setSettleThresholds(btScalar(SETTLE_SPEED), btScalar(SETTLE_ENERGY), settleWindow);
+}
+
+
+void PhysicsWorld::setTowerSize(int newBlockNo, int newLayerWidth)
+{
+	/* Set number of blocks and blocks per layer, for when the tower is next built */
+
+	if ( newBlockNo > 0 )
+		nextBlockNo = newBlockNo;
+	if ( newLayerWidth > 0 )
+		nextLayerWidth = newLayerWidth;
+}
+
+
+void PhysicsWorld::setSeed(unsigned int shapeSeed)
+{
+	/* Set seed for choosing block shapes when the tower is next constructed */
+
+	seed = shapeSeed;
+}
+
+
+void PhysicsWorld::setStepRate(int stepsPerSecond)
+{
+	/* Set number of internal simulation steps per second of real time */
+
+	if ( stepsPerSecond > 0 )
+		fixedTimeStep = btScalar(1.0/stepsPerSecond);
+	setSettleThresholds(0, 0, settleWindow);	// Keep settle window the same length of time
+}
+
+
+void PhysicsWorld::setMaxSubSteps(int maxSteps)
+{
+	/* Set limit on internal steps per call, beyond which time is dropped */
+
+	if ( maxSteps > 0 )
+		maxSubSteps = maxSteps;
+}
+
+
+void PhysicsWorld::setThreading(bool useThreads, bool requireDeterminism)
+{
+	/* Choose the multithreaded pipeline for when the world is next created */
+
+	// Threads are shared through Bullet's global scheduler, set up with setPhysicsThreads
+	nextThreaded = useThreads;
+	nextDeterministic = requireDeterminism;
+}
+
+
+bool PhysicsWorld::isThreaded() { return threaded; }
+
+
+void PhysicsWorld::setBroadphase(int type)
+{
+	/* Choose the broadphase for when the world is next created */
+
+	if ( type == BROADPHASE_DBVT || type == BROADPHASE_SWEEP || type == BROADPHASE_SIMPLE )
+		nextBroadphaseType = type;
+}
+
+
+int PhysicsWorld::getBroadphase() { return broadphaseType; }
+
+
+unsigned int PhysicsWorld::getSeed() { return seed; }
+int PhysicsWorld::getBlockNo() { return blockNo; }
+int PhysicsWorld::getLayerWidth() { return layerWidth; }
+bool PhysicsWorld::isBuilt() { return dynamicsWorld != 0; }
+btScalar PhysicsWorld::getTimeStep() { return fixedTimeStep; }
+AllocationCount PhysicsWorld::getStepAllocations() { return stepAllocations; }
+double PhysicsWorld::getStepBroadphaseTime() { return stepBroadphaseTime; }
+int PhysicsWorld::getDroppedSubSteps() { return droppedSubSteps; }
+unsigned long PhysicsWorld::getStepCount() { return stepCount; }
+
 
 void PhysicsWorld::constructTower()
 {
 	/* Add blocks to the world that form the tower */
 
 	// Define block shape templates of slightly varying heights
-	blockShape = new btBoxShape*[2];
+	blockShape = arena.createArray<btBoxShape>(2);
 	for (int i=0; i<2; i++)
-		blockShape[i] = new btBoxShape(btVector3(3.75,0.75+0.01*i,1.25));
+		blockShape[i] = arena.create<btBoxShape>(btVector3(1.25*layerWidth,0.75+0.01*i,1.25));
 
-	blockRigidBody = new btRigidBody*[BLOCK_NO];
+	blockRigidBody = arena.createArray<btRigidBody>(blockNo);
 
 	// Define attributes for a block
 	btScalar mass = 5.0f;
@@ -19,69 +133,173 @@ void PhysicsWorld::constructTower()
 	btScalar friction = 1.0f;
 	btScalar restitution = 0.0f;
 	btScalar damping = 0.15f;
+	blockWeight = mass*-dynamicsWorld->getGravity().getY();
 
-	// Add blocks in layers of three, with each layer at a right angle to neighbouring layers
-	for (int i=0; i<BLOCK_NO; i+=6) {
-		for (int j=0; j<std::min(3,BLOCK_NO-i); j++) {
+	// Own random generator, so towers depend only on the seed and worlds can be built in parallel
+	std::minstd_rand shapeRandom(seed);
+
+	// Add blocks in layers of layerWidth, with each layer at a right angle to neighbouring layers
+	for (int i=0; i<blockNo; i+=2*layerWidth) {
+		for (int j=0; j<std::min(layerWidth,blockNo-i); j++) {
 			// Define initial transformation state of block
 			btDefaultMotionState* blockMotionState =
-				new btDefaultMotionState(btTransform(btQuaternion(btVector3(0,1,0), btScalar(0*PI/180)),btVector3(0,0.75f+i*0.5f,2.5f*(j-1))));
+				arena.create<btDefaultMotionState>(btTransform(btQuaternion(btVector3(0,1,0), btScalar(0*PI/180)),btVector3(0,0.75f+i*1.5f/layerWidth,2.5f*(j-(layerWidth-1)/2.0f))));
 			// Gather construction information for block
-			btRigidBody::btRigidBodyConstructionInfo blockRigidBodyCI(mass,blockMotionState,blockShape[rand()%2],blockInertia);
+			btRigidBody::btRigidBodyConstructionInfo blockRigidBodyCI(mass,blockMotionState,blockShape[shapeRandom()%2],blockInertia);
 			blockRigidBodyCI.m_restitution = restitution;
 			// Create block
-			blockRigidBody[i+j] = new btRigidBody(blockRigidBodyCI);
+			blockRigidBody[i+j] = arena.create<btRigidBody>(blockRigidBodyCI);
 			blockRigidBody[i+j]->setAnisotropicFriction(btVector3(friction, friction*2, friction*1.2));
 			blockRigidBody[i+j]->setDamping(damping,damping*2);
+			blockRigidBody[i+j]->setUserIndex(i+j);	// Identify block in contact manifolds
 			// Add block to world
 			dynamicsWorld->addRigidBody(blockRigidBody[i+j]);
 		}
-		for (int j=3; j<std::min(6,BLOCK_NO-i); j++) {
+		for (int j=layerWidth; j<std::min(2*layerWidth,blockNo-i); j++) {
 			btDefaultMotionState* blockMotionState =
-				new btDefaultMotionState(btTransform(btQuaternion(btVector3(0,1,0), btScalar(90*PI/180)),btVector3(2.5f*(j-4),2.25f+i*0.5f,0)));
-			btRigidBody::btRigidBodyConstructionInfo blockRigidBodyCI(mass,blockMotionState,blockShape[rand()%2],blockInertia);
+				arena.create<btDefaultMotionState>(btTransform(btQuaternion(btVector3(0,1,0), btScalar(90*PI/180)),btVector3(2.5f*(j-layerWidth-(layerWidth-1)/2.0f),2.25f+i*1.5f/layerWidth,0)));
+			btRigidBody::btRigidBodyConstructionInfo blockRigidBodyCI(mass,blockMotionState,blockShape[shapeRandom()%2],blockInertia);
 			blockRigidBodyCI.m_restitution = restitution;
-			blockRigidBody[i+j] = new btRigidBody(blockRigidBodyCI);
+			blockRigidBody[i+j] = arena.create<btRigidBody>(blockRigidBodyCI);
 			blockRigidBody[i+j]->setAnisotropicFriction(btVector3(friction, friction*1.2, friction*2));
 			blockRigidBody[i+j]->setDamping(damping,damping*4);
+			blockRigidBody[i+j]->setUserIndex(i+j);
 			dynamicsWorld->addRigidBody(blockRigidBody[i+j]);
 		}
 	}
+
+	builtSeed = seed;
+}
+
+
+void PhysicsWorld::chooseShapes(unsigned int shapeSeed)
+{
+	/* Re-choose block shapes in place, drawing from the generator in the same order as constructTower */
+
+	std::minstd_rand shapeRandom(shapeSeed);
+	for (int i=0; i<blockNo; i++)
+		blockRigidBody[i]->setCollisionShape(blockShape[shapeRandom()%2]);
+
+	builtSeed = shapeSeed;
+}
+
+
+int PhysicsWorld::blockIndex(const btCollisionObject* object)
+{
+	/* Get index of block from its collision object, or -1 for the surface */
+
+	return object == surfaceRigidBody ? -1 : object->getUserIndex();
+}
+
+
+void PhysicsWorld::buildBroadphase(void* memory)
+{
+	/* Build an empty broadphase of the world's type, in the memory of a destroyed one if given */
+
+	if ( broadphaseType == BROADPHASE_SWEEP ) {
+		// Blocks are forced back once a little beyond H_SPAN, and are never lifted far above the tower.
+		// One handle is reserved, one is for the surface and the rest are for blocks.
+		btVector3 worldMin(-H_SPAN*1.5, -10, -H_SPAN*1.5);
+		btVector3 worldMax(H_SPAN*1.5, btScalar(blockNo/layerWidth*1.52+20), H_SPAN*1.5);
+		if ( blockNo+2 < 16384 )
+			broadphase = arena.createIn<btAxisSweep3>(memory, worldMin, worldMax, (unsigned short)(blockNo+2), pairCache);
+		else
+			broadphase = arena.createIn<bt32BitAxisSweep3>(memory, worldMin, worldMax, (unsigned int)(blockNo+2), pairCache);
+	}
+	else if ( broadphaseType == BROADPHASE_SIMPLE )
+		broadphase = arena.createIn<btSimpleBroadphase>(memory, blockNo+2, pairCache);
+	else
+		broadphase = arena.createIn<btDbvtBroadphase>(memory, pairCache);
 }
 
 
 void PhysicsWorld::createWorld()
 {
+	// Take on requested tower size, and make room for all blocks plus the world's own objects
+	blockNo = nextBlockNo;
+	layerWidth = nextLayerWidth;
+	arena.reserve((sizeof(btRigidBody)+sizeof(btDefaultMotionState)+64)*(blockNo+1)+48*1024);
+
 	// Build the broadphase
-	broadphase = new btDbvtBroadphase();
-	// Set up the collision configuration and dispatcher
-	collisionConfiguration = new btDefaultCollisionConfiguration();
-	dispatcher = new btCollisionDispatcher(collisionConfiguration);
-	// Set up physics solver
-	solver = new btSequentialImpulseConstraintSolver;
-
-	// Create physics world
-	dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
+	broadphaseType = nextBroadphaseType;
+	pairCache = arena.create<btHashedOverlappingPairCache>();
+	buildBroadphase(0);
+	// Set up the collision configuration and dispatcher, with contact pools sized for the tower
+	btDefaultCollisionConstructionInfo collisionCI;
+	collisionCI.m_defaultMaxPersistentManifoldPoolSize = (blockNo+1)*CONTACT_POOL_FACTOR;
+	collisionCI.m_defaultMaxCollisionAlgorithmPoolSize = (blockNo+1)*CONTACT_POOL_FACTOR;
+	collisionConfiguration = arena.create<btDefaultCollisionConfiguration>(collisionCI);
+	threaded = nextThreaded;
+	deterministic = nextDeterministic;
+	if ( threaded ) {
+		setPhysicsThreads(getPhysicsThreads());		// Make sure Bullet has a scheduler
+
+		// Narrowphase tasks add manifolds in whatever order they finish, so
+		// a deterministic world keeps the narrowphase on the calling thread
+		if ( deterministic )
+			dispatcher = arena.create<btCollisionDispatcher>(collisionConfiguration);
+		else
+			dispatcher = arena.create<btCollisionDispatcherMt>(collisionConfiguration, DISPATCH_GRAIN);
+
+		// Islands are solved in parallel, each by one solver from the pool. Large islands
+		// can also be split across threads, but the batching then depends on timing.
+		btConstraintSolverPoolMt* solverPool = arena.create<btConstraintSolverPoolMt>(BT_MAX_THREAD_COUNT);
+		solver = solverPool;
+		solverMt = deterministic ? 0 : arena.create<btSequentialImpulseConstraintSolverMt>();
+
+		// Create physics world
+		dynamicsWorld = arena.create<TowerDynamicsWorldMt>(dispatcher,broadphase,solverPool,solverMt,collisionConfiguration);
+	}
+	else {
+		dispatcher = arena.create<btCollisionDispatcher>(collisionConfiguration);
+		// Set up physics solver
+		solver = arena.create<btSequentialImpulseConstraintSolver>();
+		solverMt = 0;
+
+		// Create physics world
+		dynamicsWorld = arena.create<TowerDynamicsWorld>(dispatcher,broadphase,solver,collisionConfiguration);
+	}
 	dynamicsWorld->setGravity(btVector3(0,-12,0));
+	// Process overlapping pairs in a fixed order, so restored snapshots replay exactly
+	dynamicsWorld->getDispatchInfo().m_deterministicOverlappingPairs = true;
+	// Look at the motion after every internal step, not just after each frame
+	dynamicsWorld->setInternalTickCallback(stepCallback, this);
 
 	// Create surface shape template
-	surfaceShape = new btStaticPlaneShape(btVector3(0,1,0),1);
+	surfaceShape = arena.create<btStaticPlaneShape>(btVector3(0,1,0),1);
 
 	// Set transformation state of static surface
 	btDefaultMotionState* surfaceMotionState =
-		new btDefaultMotionState(btTransform(btQuaternion(btVector3(0,0,1), btScalar(0)),btVector3(0,-1,0)));
+		arena.create<btDefaultMotionState>(btTransform(btQuaternion(btVector3(0,0,1), btScalar(0)),btVector3(0,-1,0)));
 	// Collect construction information for surface
 	btRigidBody::btRigidBodyConstructionInfo
 		surfaceRigidBodyCI(0,surfaceMotionState,surfaceShape,btVector3(0,0,0));
 	surfaceRigidBodyCI.m_friction = 1.5;
 	// Create surface
-	surfaceRigidBody = new btRigidBody(surfaceRigidBodyCI);
+	surfaceRigidBody = arena.create<btRigidBody>(surfaceRigidBodyCI);
 	// Add surface to world
 	dynamicsWorld->addRigidBody(surfaceRigidBody);
 
 	constructTower();
+	// Find the contacts the tower is built with, so that it stands before its first step
+	dynamicsWorld->performDiscreteCollisionDetection();
+
+	timerStarted = false;	// Initialise timer - set proper value after first step
+	droppedSubSteps = 0;
+	stepCount = 0;
 
-	time = 0;	// Initialise timer - set proper value after first step
+	contacts.resize(blockNo);
+	contacts.build(dispatcher, fixedTimeStep);
+
+	settle.cancel();
+
+	state.resize(blockNo);
+	heightMask.assign(maskWords(blockNo), 0);
+	contactMask.assign(maskWords(blockNo), 0);
+	activeMask.assign(maskWords(blockNo), 0);
+	areaMask.assign(maskWords(blockNo), 0);
+
+	saveSnapshot(initialState);		// Keep initial state for resetting
 }
 
 
@@ -89,52 +307,247 @@ void PhysicsWorld::deleteWorld()
 {
 	/* Delete physics world and all variables */
 
-	for (int i=0; i<BLOCK_NO; i++) {
+	for (int i=0; i<blockNo; i++) {
 		dynamicsWorld->removeRigidBody(blockRigidBody[i]);
-		delete blockRigidBody[i]->getMotionState();
-		delete blockRigidBody[i];
+		arena.destroy(static_cast<btDefaultMotionState*>(blockRigidBody[i]->getMotionState()));
+		arena.destroy(blockRigidBody[i]);
 	}
-	delete blockRigidBody;
 
 	dynamicsWorld->removeRigidBody(surfaceRigidBody);
-	delete surfaceRigidBody->getMotionState();
-	delete surfaceRigidBody;
+	arena.destroy(static_cast<btDefaultMotionState*>(surfaceRigidBody->getMotionState()));
+	arena.destroy(surfaceRigidBody);
+
+	for (int i=0; i<2; i++)
+		arena.destroy(blockShape[i]);
 
-	delete blockShape;
+	arena.destroy(surfaceShape);
 
-	delete surfaceShape;
+	arena.destroy(dynamicsWorld);
+	dynamicsWorld = 0;
+	arena.destroy(solverMt);
+	arena.destroy(solver);
+	arena.destroy(dispatcher);
+	arena.destroy(collisionConfiguration);
+	arena.destroy(broadphase);
+	arena.destroy(pairCache);
 
-	delete dynamicsWorld;
-	delete solver;
-	delete collisionConfiguration;
-	delete dispatcher;
-	delete broadphase;
+	arena.reset();		// All world objects are gone, so their memory can be reused
 }
 
 
 void PhysicsWorld::resetWorld()
 {
-	/* Delete and re-create physics world */
+	/* Return tower to its initial state, reusing the existing physics world */
+
+	if ( recorder ) {
+		double values[1] = { double(seed) };
+		recorder->add(stepCount, LOG_RESET, -1, values, 1);
+	}
+
+	// A different size of tower, threading mode or broadphase needs building from scratch
+	if ( nextBlockNo != blockNo || nextLayerWidth != layerWidth ||
+		nextThreaded != threaded || nextDeterministic != deterministic || nextBroadphaseType != broadphaseType ) {
+		deleteWorld();
+		createWorld();
+		return;
+	}
+
+	initialState.seed = seed;	// Pick up any change of seed since the tower was built
+	restoreSnapshot(initialState);
+}
+
+
+void PhysicsWorld::saveSnapshot(WorldSnapshot& snapshot)
+{
+	/* Record dynamic state of all blocks, cached contacts and step timing */
+
+	snapshot.bodies.resize(blockNo);
+	for (int i=0; i<blockNo; i++) {
+		btRigidBody* body = blockRigidBody[i];
+		BodyState& state = snapshot.bodies[i];
+
+		state.worldTrans = body->getWorldTransform();
+		state.interpolationTrans = body->getInterpolationWorldTransform();
+		state.graphicsTrans = static_cast<btDefaultMotionState*>(body->getMotionState())->m_graphicsWorldTrans;
+		state.linearVelocity = body->getLinearVelocity();
+		state.angularVelocity = body->getAngularVelocity();
+		state.interpolationLinearVelocity = body->getInterpolationLinearVelocity();
+		state.interpolationAngularVelocity = body->getInterpolationAngularVelocity();
+		state.totalForce = body->getTotalForce();
+		state.totalTorque = body->getTotalTorque();
+		state.activationState = body->getActivationState();
+		state.deactivationTime = body->getDeactivationTime();
+	}
+
+	// Record contact points, growing storage only when there are more manifolds than ever before
+	int numManifolds = dispatcher->getNumManifolds();
+	if ( int(snapshot.manifolds.size()) < numManifolds )
+		snapshot.manifolds.resize(numManifolds);
+
+	snapshot.manifoldNo = 0;
+	for (int i=0; i<numManifolds; i++) {
+		btPersistentManifold* contactManifold = dispatcher->getManifoldByIndexInternal(i);
+		if ( contactManifold->getNumContacts() == 0 )
+			continue;
 
-	deleteWorld();
-	createWorld();
+		ManifoldState& manifoldState = snapshot.manifolds[snapshot.manifoldNo++];
+		manifoldState.body0 = blockIndex(contactManifold->getBody0());
+		manifoldState.body1 = blockIndex(contactManifold->getBody1());
+		manifoldState.contactNo = contactManifold->getNumContacts();
+		for (int j=0; j<manifoldState.contactNo; j++)
+			manifoldState.contacts[j] = contactManifold->getContactPoint(j);
+	}
+
+	snapshot.localTime = getLocalTime();
+	snapshot.stepCount = stepCount;
+	snapshot.droppedSubSteps = droppedSubSteps;
+	snapshot.seed = builtSeed;
+}
+
+
+void PhysicsWorld::restoreSnapshot(const WorldSnapshot& snapshot)
+{
+	/* Return world to a recorded state in place, re-creating only the broadphase */
+
+	if ( snapshot.seed != builtSeed )
+		chooseShapes(snapshot.seed);
+
+	// Take every object out of the broadphase, returning its pairs and contacts to their pools
+	for (int i=0; i<blockNo; i++)
+		dynamicsWorld->removeRigidBody(blockRigidBody[i]);
+	dynamicsWorld->removeRigidBody(surfaceRigidBody);
+
+	for (int i=0; i<blockNo; i++) {
+		btRigidBody* body = blockRigidBody[i];
+		const BodyState& state = snapshot.bodies[i];
+
+		body->setCenterOfMassTransform(state.worldTrans);	// Also updates world inertia
+		body->setInterpolationWorldTransform(state.interpolationTrans);
+		static_cast<btDefaultMotionState*>(body->getMotionState())->m_graphicsWorldTrans = state.graphicsTrans;
+		body->setLinearVelocity(state.linearVelocity);
+		body->setAngularVelocity(state.angularVelocity);
+		body->setInterpolationLinearVelocity(state.interpolationLinearVelocity);
+		body->setInterpolationAngularVelocity(state.interpolationAngularVelocity);
+		body->clearForces();
+		body->applyCentralForce(state.totalForce);
+		body->applyTorque(state.totalTorque);
+		body->forceActivationState(state.activationState);
+		body->setDeactivationTime(state.deactivationTime);
+	}
+
+	// A broadphase only looks for new pairs when a proxy leaves its old bounds, which a block put back
+	// where it was never does, so rebuild it and add the objects in the order the world was built in.
+	// Touching blocks are then paired at once, in the same order as in a freshly built world.
+	arena.destroy(broadphase);
+	buildBroadphase(broadphase);
+	dynamicsWorld->setBroadphase(broadphase);
+	dynamicsWorld->addRigidBody(surfaceRigidBody);
+	for (int i=0; i<blockNo; i++)
+		dynamicsWorld->addRigidBody(blockRigidBody[i]);
+
+	settle.cancel();				// Motion being watched for no longer exists
+	solver->reset();				// Restart solver's random sequence
+	if ( solverMt )
+		solverMt->reset();
+	setLocalTime(snapshot.localTime);
+
+	// Re-create recorded contacts, so the solver is warm-started exactly as before
+	if ( snapshot.manifoldNo > 0 ) {
+		dynamicsWorld->performDiscreteCollisionDetection();
+
+		int numManifolds = dispatcher->getNumManifolds();
+		for (int i=0; i<numManifolds; i++) {
+			btPersistentManifold* contactManifold = dispatcher->getManifoldByIndexInternal(i);
+			int body0 = blockIndex(contactManifold->getBody0());
+			int body1 = blockIndex(contactManifold->getBody1());
+
+			contactManifold->clearManifold();
+			for (int j=0; j<snapshot.manifoldNo; j++) {
+				const ManifoldState& manifoldState = snapshot.manifolds[j];
+				if ( manifoldState.body0 == body0 && manifoldState.body1 == body1 ) {
+					for (int k=0; k<manifoldState.contactNo; k++)
+						contactManifold->addManifoldPoint(manifoldState.contacts[k]);
+					break;
+				}
+			}
+		}
+	}
+
+	contacts.build(dispatcher, fixedTimeStep);
+
+	stepCount = snapshot.stepCount;
+	droppedSubSteps = snapshot.droppedSubSteps;
+	timerStarted = false;
 }
 
 
 void PhysicsWorld::stepWorld(btTransform* boxTrans)
 {
-	/* Step the simulation by the amount of time passed since last step */
-	if ( time == 0 )
-		dynamicsWorld->stepSimulation(1/60.f, 10);		// First step
-	else {
-		time = clock() - time;	// Get time passed
-		dynamicsWorld->stepSimulation(float(time)/float(CLOCKS_PER_SEC), 10);
+	/* Step the simulation by the amount of wall-clock time passed since last step */
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	if ( !timerStarted ) {
+		advanceWorld(fixedTimeStep, boxTrans);		// First step
+		timerStarted = true;
 	}
-	time = clock();		// Restart timer for next step
+	else
+		advanceWorld(std::chrono::duration<btScalar>(now-stepTime).count(), boxTrans);
 
-	// Get current transformation states for all blocks
-	for (int i=0; i<BLOCK_NO; i++)
+	stepTime = now;		// Restart timer for next step
+}
+
+
+int PhysicsWorld::advanceWorld(btScalar timePassed, btTransform* boxTrans)
+{
+	/* Advance the simulation by a given amount of time, in fixed internal steps */
+
+	// Bullet accumulates the time and runs as many fixed steps as fit into it.
+	// Any steps beyond maxSubSteps are dropped, so a slow frame cannot snowball.
+	if ( recorder ) {
+		double values[1] = { double(timePassed) };
+		recorder->add(stepCount, LOG_ADVANCE, -1, values, 1);
+	}
+
+	// Bullet's worker threads count on their own counters, so a threaded world takes the process
+	// totals - which also take in any other world stepping at the same time
+	AllocationCount before = threaded ? getTotalAllocations() : getThreadAllocations();
+	double broadphaseBefore = getThreadBroadphaseTime();
+	int subSteps = dynamicsWorld->stepSimulation(timePassed, maxSubSteps, fixedTimeStep);
+	AllocationCount after = threaded ? getTotalAllocations() : getThreadAllocations();
+	stepAllocations.allocations = after.allocations-before.allocations;
+	stepAllocations.bytes = after.bytes-before.bytes;
+	stepBroadphaseTime = getThreadBroadphaseTime()-broadphaseBefore;
+
+	if ( subSteps > maxSubSteps ) {
+		droppedSubSteps += subSteps-maxSubSteps;
+		subSteps = maxSubSteps;
+	}
+	stepCount += subSteps;
+
+	// Index contacts once per step, so per-block queries need not scan every manifold
+	if ( subSteps > 0 )
+		contacts.build(dispatcher, fixedTimeStep);
+
+	// Get current transformation states for all blocks. Motion states hold
+	// transforms interpolated between the last two internal steps, according
+	// to the leftover time, so rendering stays smooth at any frame rate.
+	// Positions, velocities and activation are also copied out as arrays for the batch checks.
+	for (int i=0; i<blockNo; i++) {
 		blockRigidBody[i]->getMotionState()->getWorldTransform(boxTrans[i]);
+
+		const btVector3& origin = boxTrans[i].getOrigin();
+		const btVector3& velocity = blockRigidBody[i]->getLinearVelocity();
+		state.x[i] = float(origin.getX());
+		state.y[i] = float(origin.getY());
+		state.z[i] = float(origin.getZ());
+		state.vx[i] = float(velocity.getX());
+		state.vy[i] = float(velocity.getY());
+		state.vz[i] = float(velocity.getZ());
+		state.active[i] = blockRigidBody[i]->isActive() ? 1 : 0;
+	}
+
+	return subSteps;
 }
 
 
@@ -157,7 +570,7 @@ float PhysicsWorld::getSurfaceHeight()
 }
 
 
-boolean PhysicsWorld::isActive(int objectIndex)
+bool PhysicsWorld::isActive(int objectIndex)
 {
 	/* Check if block is active */
 
@@ -168,26 +581,149 @@ boolean PhysicsWorld::isActive(int objectIndex)
 }
 
 
-boolean PhysicsWorld::checkContact(int objectIndex)
+bool PhysicsWorld::checkContact(int objectIndex)
 {
 	/* Check if block is in contact with any other block */
 
-	if ( objectIndex >= 0 ) {
-		int numManifolds = dynamicsWorld->getDispatcher()->getNumManifolds();
-		for (int i=0; i<numManifolds; i++) {
-			btPersistentManifold* contactManifold = dynamicsWorld->getDispatcher()->getManifoldByIndexInternal(i);
-			if ( ( contactManifold->getBody0() == blockRigidBody[objectIndex] ||
-				contactManifold->getBody1() == blockRigidBody[objectIndex] ) &&
-				!( contactManifold->getBody0() == surfaceRigidBody ||
-				contactManifold->getBody1() == surfaceRigidBody ) &&
-				contactManifold->getNumContacts() > 0
-			) {
-				return 1;
-			}
+	if ( objectIndex >= 0 )
+		return contacts.hasBlockContact(objectIndex);
+	else
+		return 0;
+}
+
+
+bool PhysicsWorld::checkGroundContact(int objectIndex)
+{
+	/* Check if block is in contact with the surface */
+
+	if ( objectIndex >= 0 )
+		return contacts.hasGroundContact(objectIndex);
+	else
+		return 0;
+}
+
+
+int PhysicsWorld::getNeighbourNo(int objectIndex)
+{
+	/* Get number of blocks in contact with block */
+
+	if ( objectIndex >= 0 )
+		return contacts.getNeighbourNo(objectIndex);
+	else
+		return 0;
+}
+
+
+const ContactEdge* PhysicsWorld::getNeighbours(int objectIndex)
+{
+	/* Get blocks in contact with block, and the number of contact points with each */
+
+	if ( objectIndex >= 0 )
+		return contacts.getNeighbours(objectIndex);
+	else
+		return 0;
+}
+
+
+int PhysicsWorld::getContactPoints(std::vector<ContactPoint>& points)
+{
+	/* Get every point where bodies touch, with the normal force the solver applied there in the last step */
+
+	points.clear();
+	int numManifolds = dispatcher->getNumManifolds();
+	for (int i=0; i<numManifolds; i++) {
+		btPersistentManifold* contactManifold = dispatcher->getManifoldByIndexInternal(i);
+		int body0 = blockIndex(contactManifold->getBody0());
+		int body1 = blockIndex(contactManifold->getBody1());
+
+		for (int j=0; j<contactManifold->getNumContacts(); j++) {
+			const btManifoldPoint& point = contactManifold->getContactPoint(j);
+			if ( point.getDistance() > 0.02 )
+				continue;		// Kept for warm-starting, but not touching
+
+			ContactPoint contact;
+			contact.body0 = body0;
+			contact.body1 = body1;
+			contact.position = (point.getPositionWorldOnA()+point.getPositionWorldOnB())*btScalar(0.5);
+			contact.normal = point.m_normalWorldOnB;
+			contact.force = point.m_appliedImpulse/fixedTimeStep;
+			contact.friction = point.m_combinedFriction;
+			points.push_back(contact);
 		}
 	}
 
-	return 0;
+	return int(points.size());
+}
+
+
+btScalar PhysicsWorld::getBlockWeight() { return blockWeight; }
+
+
+btScalar PhysicsWorld::getLoad(int objectIndex)
+{
+	/* Get weight carried by block, from the solver's contact impulses, in units of block weight */
+
+	if ( objectIndex >= 0 )
+		return contacts.getLoad(objectIndex)/blockWeight;
+	else
+		return 0;
+}
+
+
+bool PhysicsWorld::isSafeToRemove(int objectIndex, double maxHeight)
+{
+	/* Estimate whether block can be removed without toppling anything, if below given height */
+
+	if ( objectIndex >= 0 )
+		return blockRigidBody[objectIndex]->getWorldTransform().getOrigin().getY() < maxHeight &&
+			contacts.getLoad(objectIndex) < SAFE_LOAD*blockWeight;
+	else
+		return 0;
+}
+
+
+int PhysicsWorld::findObjectAt(double* point, const btTransform* trans)
+{
+	/* Get index of block whose surface or interior contains point, or -1 if none. Blocks
+	   are taken where trans puts them if given, so another thread may be stepping the world. */
+
+	const btScalar tolerance = 0.05;	// Allowance for depth buffer precision
+	btVector3 worldPoint(point[0], point[1], point[2]);
+	int closestIndex = -1;
+	btScalar closestExcess = tolerance;
+
+	for (int i=0; i<blockNo; i++) {
+		// Distance of point outside block, along the axis where it is furthest out
+		btVector3 localPoint = ( trans ? trans[i] : blockRigidBody[i]->getWorldTransform() ).invXform(worldPoint);
+		btVector3 halfExtents = static_cast<const btBoxShape*>(blockRigidBody[i]->getCollisionShape())->getHalfExtentsWithMargin();
+		btScalar excess = std::max(btFabs(localPoint.getX())-halfExtents.getX(),
+			std::max(btFabs(localPoint.getY())-halfExtents.getY(), btFabs(localPoint.getZ())-halfExtents.getZ()));
+
+		if ( excess < closestExcess ) {
+			closestExcess = excess;
+			closestIndex = i;
+		}
+	}
+
+	return closestIndex;
+}
+
+
+bool PhysicsWorld::castRay(const btVector3& rayFrom, const btVector3& rayTo, int& objectIndex, btVector3& hitPoint)
+{
+	/* Find the first block or surface along a ray, giving the block index (-1 for surface) and point hit */
+
+	btCollisionWorld::ClosestRayResultCallback rayCallback(rayFrom, rayTo);
+	dynamicsWorld->rayTest(rayFrom, rayTo, rayCallback);
+
+	if ( !rayCallback.hasHit() ) {
+		objectIndex = -1;
+		return false;
+	}
+
+	objectIndex = blockIndex(rayCallback.m_collisionObject);
+	hitPoint = rayCallback.m_hitPointWorld;
+	return true;
 }
 
 
@@ -196,6 +732,10 @@ void PhysicsWorld::pushObject(int objectIndex, double impulse, double* mouseRay)
 	/* Apply central, horizontal impulse to block */
 
 	if (objectIndex >= 0) {
+		if ( recorder ) {
+			double values[4] = { impulse, mouseRay[0], mouseRay[1], mouseRay[2] };
+			recorder->add(stepCount, LOG_PUSH, objectIndex, values, 4);
+		}
 		btVector3 boxOrigin = blockRigidBody[objectIndex]->getWorldTransform().getOrigin();
 		blockRigidBody[objectIndex]->activate();
 		blockRigidBody[objectIndex]->applyCentralImpulse(
@@ -214,6 +754,8 @@ void PhysicsWorld::turnObject(int objectIndex, double impulse)
 	/* Apply torque to block */
 
 	if (objectIndex >= 0) {
+		if ( recorder )
+			recorder->add(stepCount, LOG_TURN, objectIndex, &impulse, 1);
 		blockRigidBody[objectIndex]->activate();
 		blockRigidBody[objectIndex]->applyTorqueImpulse(btVector3(0,impulse,0));
 	}
@@ -225,6 +767,10 @@ void PhysicsWorld::dragObject(int objectIndex, double* mouseRay, double* objectS
 	/* Set linear velocity of block to move towards mouse target */
 
 	if (objectIndex >= 0) {
+		if ( recorder ) {
+			double values[6] = { mouseRay[0], mouseRay[1], mouseRay[2], objectSelect[0], objectSelect[1], objectSelect[2] };
+			recorder->add(stepCount, LOG_DRAG, objectIndex, values, 6);
+		}
 		btVector3 boxOrigin = blockRigidBody[objectIndex]->getWorldTransform().getOrigin();
 		btVector3 boxRotateAxis = blockRigidBody[objectIndex]->getWorldTransform().getRotation().getAxis();
 		blockRigidBody[objectIndex]->activate();
@@ -252,6 +798,8 @@ void PhysicsWorld::raiseObjectTo(int objectIndex, double height)
 	/* Set linear velocity of block towards given height */
 
 	if ( objectIndex >= 0 ) {
+		if ( recorder )
+			recorder->add(stepCount, LOG_RAISE, objectIndex, &height, 1);
 		btVector3 boxOrigin = blockRigidBody[objectIndex]->getWorldTransform().getOrigin();
 		blockRigidBody[objectIndex]->activate();
 		blockRigidBody[objectIndex]->
@@ -267,6 +815,8 @@ void PhysicsWorld::stopObject(int objectIndex)
 	/* Cancel all block velocity */
 
 	if ( objectIndex >= 0 ) {
+		if ( recorder )
+			recorder->add(stepCount, LOG_STOP, objectIndex);
 		blockRigidBody[objectIndex]->setLinearVelocity(btVector3(0,0,0));
 		blockRigidBody[objectIndex]->setAngularVelocity(btVector3(0,0,0));
 	}
@@ -278,9 +828,210 @@ void PhysicsWorld::centerObject(int objectIndex)
 	/* Apply force to block, towards centre of world */
 
 	if ( objectIndex >= 0 ) {
+		if ( recorder )
+			recorder->add(stepCount, LOG_CENTER, objectIndex);
 		btVector3 boxOrigin = blockRigidBody[objectIndex]->getWorldTransform().getOrigin();
 		btVector3 boxVelocity = blockRigidBody[objectIndex]->getLinearVelocity();
 		blockRigidBody[objectIndex]->
 			applyCentralForce(btVector3(-boxOrigin.getX(), 0, -boxOrigin.getZ()));
 	}
 }
+
+
+void PhysicsWorld::placeObject(int objectIndex, const btVector3& origin, double yaw)
+{
+	/* Put block down at rest, upright and turned yaw degrees about the vertical */
+
+	if ( objectIndex >= 0 ) {
+		if ( recorder ) {
+			double values[4] = { origin.getX(), origin.getY(), origin.getZ(), yaw };
+			recorder->add(stepCount, LOG_PLACE, objectIndex, values, 4);
+		}
+		btRigidBody* body = blockRigidBody[objectIndex];
+		btTransform placeTrans(btQuaternion(btVector3(0,1,0), btScalar(yaw*PI/180)), origin);
+		body->setCenterOfMassTransform(placeTrans);
+		body->setInterpolationWorldTransform(placeTrans);
+		static_cast<btDefaultMotionState*>(body->getMotionState())->m_graphicsWorldTrans = placeTrans;
+		body->setLinearVelocity(btVector3(0,0,0));
+		body->setAngularVelocity(btVector3(0,0,0));
+		body->setInterpolationLinearVelocity(btVector3(0,0,0));
+		body->setInterpolationAngularVelocity(btVector3(0,0,0));
+		body->activate(true);
+		dynamicsWorld->updateSingleAabb(body);
+	}
+}
+
+
+btScalar PhysicsWorld::getLocalTime()
+{
+	/* Get time accumulated towards the next internal step */
+
+	if ( threaded )
+		return static_cast<TowerDynamicsWorldMt*>(dynamicsWorld)->getLocalTime();
+	else
+		return static_cast<TowerDynamicsWorld*>(dynamicsWorld)->getLocalTime();
+}
+
+
+void PhysicsWorld::setLocalTime(btScalar time)
+{
+	/* Set time accumulated towards the next internal step */
+
+	if ( threaded )
+		static_cast<TowerDynamicsWorldMt*>(dynamicsWorld)->setLocalTime(time);
+	else
+		static_cast<TowerDynamicsWorld*>(dynamicsWorld)->setLocalTime(time);
+}
+
+
+const TowerState& PhysicsWorld::getState() { return state; }
+
+
+TowerCheck PhysicsWorld::checkTower(double standHeight, int heldIndex)
+{
+	/* Check whether the tower is standing, whether a block has fallen and whether anything moves, for all blocks at once */
+
+	maskGreater(state.y.data(), blockNo, float(standHeight), heightMask.data());
+	maskPositive(contacts.getBlockContactCounts(), blockNo, contactMask.data());
+	maskNonZero(state.active.data(), blockNo, activeMask.data());
+
+	TowerCheck check = { false, false, false };
+	int words = maskWords(blockNo);
+	for ( int w=0; w<words; w++ ) {
+		// Only the bits for existing blocks count in the last word
+		uint64_t blocks = ( w == words-1 && blockNo%64 ) ? ( uint64_t(1) << (blockNo%64) )-1 : ~uint64_t(0);
+		if ( heldIndex >= 0 && heldIndex>>6 == w )
+			blocks &= ~( uint64_t(1) << (heldIndex&63) );
+
+		if ( heightMask[w] & contactMask[w] )
+			check.standing = true;
+		if ( ~activeMask[w] & ~contactMask[w] & blocks )
+			check.fallen = true;
+		if ( activeMask[w] )
+			check.active = true;
+	}
+
+	return check;
+}
+
+
+int PhysicsWorld::recenterBlocks(double areaLimit)
+{
+	/* Force any block beyond the play area back to the centre, returning how many were moved */
+
+	maskEitherGreater(state.x.data(), state.z.data(), blockNo, float(areaLimit), areaMask.data());
+
+	int moved = 0;
+	for ( int w=0; w<maskWords(blockNo); w++ ) {
+		// Visit set bits only - nearly always none
+		for ( uint64_t bits=areaMask[w]; bits; bits&=bits-1 ) {
+			int objectIndex = w*64;
+			for ( uint64_t bit=bits&(~bits+1); bit>1; bit>>=1 )
+				objectIndex++;
+			centerObject(objectIndex);
+			moved++;
+		}
+	}
+
+	return moved;
+}
+
+
+bool PhysicsWorld::isTowerActive()
+{
+	/* Check if any block is still moving */
+
+	maskNonZero(state.active.data(), blockNo, activeMask.data());
+	return maskAny(activeMask.data(), blockNo);
+}
+
+
+void PhysicsWorld::stepCallback(btDynamicsWorld* world, btScalar /*timeStep*/)
+{
+	/* Called by Bullet after each internal step */
+
+	static_cast<PhysicsWorld*>(world->getWorldUserInfo())->measureMotion();
+}
+
+
+void PhysicsWorld::measureMotion()
+{
+	/* Total kinetic energy and peak speed of awake blocks, for the settle detector */
+
+	if ( !settle.isWatching() )
+		return;		// Nothing waiting, so save a pass over every block
+
+	btScalar energy = 0;
+	btScalar peakSpeed2 = 0;
+	bool allAsleep = true;
+
+	for (int i=0; i<blockNo; i++) {
+		btRigidBody* body = blockRigidBody[i];
+		if ( !body->isActive() )
+			continue;	// Sleeping islands have no motion to add
+		allAsleep = false;
+
+		// Spin is taken into the block's own frame, where its inertia is diagonal
+		btVector3 spin = body->getAngularVelocity()*body->getWorldTransform().getBasis();
+		btScalar speed2 = body->getLinearVelocity().length2();
+		energy += btScalar(0.5)*( body->getMass()*speed2 + (spin*spin).dot(body->getLocalInertia()) );
+		peakSpeed2 = std::max(peakSpeed2, speed2);
+	}
+
+	settle.addStep(energy/std::max(1, blockNo), btSqrt(peakSpeed2), allAsleep);
+}
+
+
+void PhysicsWorld::setSettleThresholds(btScalar speedLimit, btScalar energyLimit, btScalar window)
+{
+	/* Set limits within which the tower is at rest - peak block speed, kinetic energy per block and time to stay still */
+
+	if ( window > 0 )
+		settleWindow = window;
+	settle.setThresholds(speedLimit, energyLimit, std::max(1, int(ceil(settleWindow/fixedTimeStep))));
+}
+
+
+void PhysicsWorld::watchSettle(const std::function<void()>& callback)
+{
+	/* Call back once, from within stepping, as soon as the tower is at rest */
+
+	settle.watch(callback);
+}
+
+
+void PhysicsWorld::cancelSettle() { settle.cancel(); }
+
+
+void PhysicsWorld::startRecording(InputLog* log)
+{
+	/* Reset the world and log every change made to it from now on */
+
+	recorder = 0;
+	resetWorld();		// Replays reset the world the same way before applying the log
+	log->begin(seed, blockNo, layerWidth, int(floor(1/fixedTimeStep+0.5)), maxSubSteps, threaded, deterministic);
+	recorder = log;
+}
+
+
+void PhysicsWorld::stopRecording()
+{
+	/* Stop logging changes, keeping the final state of the blocks in the log */
+
+	if ( !recorder )
+		return;
+
+	std::vector<btTransform> trans(blockNo);
+	for (int i=0; i<blockNo; i++)
+		trans[i] = blockRigidBody[i]->getWorldTransform();
+	recorder->end(trans.data(), blockNo);
+	recorder = 0;
+}
+
+
+const btTransform& PhysicsWorld::getBlockTransform(int objectIndex)
+{
+	/* Get simulated (not interpolated) transformation of block */
+
+	return blockRigidBody[objectIndex]->getWorldTransform();
+}
\ No newline at end of file
@@ -1,35 +1,163 @@
+// Dynamics world with access to its step accumulator, so that snapshots can restore it
+class TowerDynamicsWorld : public btDiscreteDynamicsWorld
+{
+public:
+	TowerDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* broadphase,
+		btConstraintSolver* solver, btCollisionConfiguration* collisionConfiguration)
+		: btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration) {}
+
+	btScalar getLocalTime() { return m_localTime; }
+	void setLocalTime(btScalar time) { m_localTime = time; }
+};
+
+// Multithreaded counterpart, solving separate islands and narrowphase pairs in parallel
+class TowerDynamicsWorldMt : public btDiscreteDynamicsWorldMt
+{
+public:
+	TowerDynamicsWorldMt(btDispatcher* dispatcher, btBroadphaseInterface* broadphase,
+		btConstraintSolverPoolMt* solverPool, btConstraintSolver* solverMt, btCollisionConfiguration* collisionConfiguration)
+		: btDiscreteDynamicsWorldMt(dispatcher, broadphase, solverPool, solverMt, collisionConfiguration) {}
+
+	btScalar getLocalTime() { return m_localTime; }
+	void setLocalTime(btScalar time) { m_localTime = time; }
+};
+
+
+// Outcome of the per-frame checks on the whole tower
+struct TowerCheck
+{
+	bool standing;	// A block above the standing height is touching another block
+	bool fallen;	// A block other than the held one has come to rest away from the tower
+	bool active;	// Any block is still moving
+};
+
+
 class PhysicsWorld
 {
+	WorldArena arena;		// Memory for all objects making up the physics world
+
 	// Settings for calculating physics
 	btBroadphaseInterface* broadphase;
+	btHashedOverlappingPairCache* pairCache;	// Pairs found by the broadphase, kept when it is rebuilt
 	btDefaultCollisionConfiguration* collisionConfiguration;
 	btCollisionDispatcher* dispatcher;
-	btSequentialImpulseConstraintSolver* solver;
+	btConstraintSolver* solver;			// Single solver, or pool of solvers when threaded
+	btConstraintSolver* solverMt;		// Solver for islands too large for one thread (0 if unused)
+
+	btDiscreteDynamicsWorld* dynamicsWorld;		// The physics world - a TowerDynamicsWorld or TowerDynamicsWorldMt
+
+	int broadphaseType;			// Kind of broadphase the world uses (BROADPHASE_*)
+	int nextBroadphaseType;		// Broadphase to use when the world is next created
 
-	btDiscreteDynamicsWorld* dynamicsWorld;		// The physics world
+	bool threaded;				// Whether the world uses Bullet's multithreaded pipeline
+	bool deterministic;			// Whether threaded stepping must give the same results as running it in turn
+	bool nextThreaded;			// Threading mode to use when the world is next created
+	bool nextDeterministic;
 
 	btStaticPlaneShape* surfaceShape;	// Surface shape template
 	btBoxShape** blockShape;			// Array for block shape templates
 	btRigidBody* surfaceRigidBody;		// Static surface object
 	btRigidBody** blockRigidBody;		// Array for Block object
 
-	clock_t time;	// Timer for stepping in real-time
+	std::chrono::steady_clock::time_point stepTime;	// Wall-clock timer for stepping in real-time
+	bool timerStarted;		// Whether stepTime holds the time of a previous step
+
+	btScalar fixedTimeStep;		// Duration of a single internal simulation step
+	int maxSubSteps;			// Maximum internal steps taken per call to stepWorld
+	int droppedSubSteps;		// Internal steps discarded to avoid falling behind real-time
+	unsigned long stepCount;	// Internal steps simulated since the world was created
+	AllocationCount stepAllocations;	// Bullet heap allocations made by the last advanceWorld - when threaded,
+										// counted process-wide, so only exact while no other world steps
+	double stepBroadphaseTime;	// Seconds the last advanceWorld spent updating broadphase proxies and pairs
+
+	int blockNo;				// Number of blocks in the tower
+	int layerWidth;				// Number of blocks in each layer
+	int nextBlockNo;			// Tower size to use when the world is next created
+	int nextLayerWidth;
+
+	unsigned int seed;			// Seed for choosing block shapes
+	unsigned int builtSeed;		// Seed that chose the current block shapes
 
+	ContactGraph contacts;		// Which blocks touch which, and the forces between them, as of the last step
+	btScalar blockWeight;		// Weight of a single block, for scaling loads
+
+	TowerState state;			// Copy of block positions, velocities and activation, as of the last advance
+	std::vector<uint64_t> heightMask;	// Per-block bit masks filled by the batch tower checks
+	std::vector<uint64_t> contactMask;
+	std::vector<uint64_t> activeMask;
+	std::vector<uint64_t> areaMask;
+
+	SettleDetector settle;		// Watches for the tower coming to rest after each internal step
+	btScalar settleWindow;		// Time the tower must stay still to be at rest
+
+	InputLog* recorder;			// Log of every change made to the world, if recording (0 if not)
+
+	WorldSnapshot initialState;	// State of the world straight after the tower is constructed
+
+	void buildBroadphase(void* memory);
 	void constructTower();
+	void chooseShapes(unsigned int shapeSeed);
+	int blockIndex(const btCollisionObject* object);
+	btScalar getLocalTime();
+	void setLocalTime(btScalar time);
+	static void stepCallback(btDynamicsWorld* world, btScalar timeStep);
+	void measureMotion();
 
 public:
+	PhysicsWorld();
+	void setSeed(unsigned int shapeSeed);
+	unsigned int getSeed();
+	void setTowerSize(int newBlockNo, int newLayerWidth);
+	int getBlockNo();
+	int getLayerWidth();
+	void setStepRate(int stepsPerSecond);
+	btScalar getTimeStep();
+	void setMaxSubSteps(int maxSteps);
+	void setThreading(bool useThreads, bool requireDeterminism);
+	void setBroadphase(int type);
+	int getBroadphase();
+	bool isThreaded();
+	bool isBuilt();
+	int getDroppedSubSteps();
+	unsigned long getStepCount();
+	AllocationCount getStepAllocations();
+	double getStepBroadphaseTime();
+
 	void createWorld();
 	void deleteWorld();
 	void resetWorld();
+	void saveSnapshot(WorldSnapshot& snapshot);
+	void restoreSnapshot(const WorldSnapshot& snapshot);
 	void stepWorld(btTransform* trans);
+	int advanceWorld(btScalar timePassed, btTransform* trans);
 	btVector3 getBoxExtents();
 	float getSurfaceHeight();
-	boolean isActive(int objectIndex);
-	boolean checkContact(int objectIndex);
+	bool isActive(int objectIndex);
+	bool checkContact(int objectIndex);
+	bool checkGroundContact(int objectIndex);
+	int getNeighbourNo(int objectIndex);
+	const ContactEdge* getNeighbours(int objectIndex);
+	int getContactPoints(std::vector<ContactPoint>& points);
+	btScalar getBlockWeight();
+	btScalar getLoad(int objectIndex);
+	bool isSafeToRemove(int objectIndex, double maxHeight);
+	int findObjectAt(double* point, const btTransform* trans=0);
+	bool castRay(const btVector3& rayFrom, const btVector3& rayTo, int& objectIndex, btVector3& hitPoint);
+	const TowerState& getState();
+	TowerCheck checkTower(double standHeight, int heldIndex);
+	int recenterBlocks(double areaLimit);
+	bool isTowerActive();
+	void setSettleThresholds(btScalar speedLimit, btScalar energyLimit, btScalar window);
+	void watchSettle(const std::function<void()>& callback);
+	void cancelSettle();
+	void startRecording(InputLog* log);
+	void stopRecording();
+	const btTransform& getBlockTransform(int objectIndex);
 	void pushObject(int objectIndex, double impulse, double* mouseRay);
 	void turnObject(int objectIndex, double impulse);
 	void dragObject(int objectIndex, double* mouseRay, double* objectSelect);
 	void raiseObjectTo(int objectIndex, double height);
 	void stopObject(int objectIndex);
 	void centerObject(int objectIndex);
+	void placeObject(int objectIndex, const btVector3& origin, double yaw);
 };
\ No newline at end of file
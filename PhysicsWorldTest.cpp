@@ -0,0 +1,105 @@
+#include "BlockTowerPhysics.h"
+
+/* Checks snapshots and resets of the physics world, run by ctest */
+
+#define STEP_NO 240			// Internal steps to compare worlds over
+#define DRIFT_LIMIT 0.01		// Most a standing tower's blocks may move in total once restored elsewhere
+
+int failureNo = 0;
+const char* broadphaseNames[3] = { "dbvt", "sweep", "simple" };
+
+
+void check(bool condition, const char* description, const char* broadphaseName)
+{
+	/* Report a failed check, carrying on with the rest */
+
+	if ( !condition ) {
+		printf("FAILED (%s): %s\n", broadphaseName, description);
+		failureNo++;
+	}
+}
+
+
+void stepFor(PhysicsWorld& world, int stepNo, std::vector<btTransform>& trans)
+{
+	/* Take the given number of whole internal steps */
+
+	for ( int step = 0; step < stepNo; step++ )
+		world.advanceWorld(world.getTimeStep(), trans.data());
+}
+
+
+bool sameTransforms(PhysicsWorld& first, PhysicsWorld& second)
+{
+	/* Whether every block is in exactly the same place in both worlds */
+
+	for ( int i = 0; i < first.getBlockNo(); i++ ) {
+		if ( !(first.getBlockTransform(i) == second.getBlockTransform(i)) )
+			return false;
+	}
+	return true;
+}
+
+
+int main()
+{
+	for ( int type = BROADPHASE_DBVT; type <= BROADPHASE_SIMPLE; type++ ) {
+		const char* name = broadphaseNames[type];
+
+		// Freshly built tower, left to stand
+		PhysicsWorld fresh;
+		fresh.setBroadphase(type);
+		fresh.createWorld();
+		std::vector<btTransform> freshTrans(fresh.getBlockNo());
+		stepFor(fresh, STEP_NO, freshTrans);
+
+		// Tower of other shapes knocked about, then reset to the first tower's seed
+		PhysicsWorld reset;
+		reset.setBroadphase(type);
+		reset.setSeed(2);
+		reset.createWorld();
+		std::vector<btTransform> resetTrans(reset.getBlockNo());
+		reset.raiseObjectTo(0, 10);
+		reset.turnObject(reset.getBlockNo()/2, 50);
+		stepFor(reset, STEP_NO/2, resetTrans);
+		reset.setSeed(1);
+		reset.resetWorld();
+		stepFor(reset, STEP_NO, resetTrans);
+		check(sameTransforms(fresh, reset), "a reset world moves exactly as a freshly built one", name);
+
+		// Resetting again straight away must give the same again
+		reset.resetWorld();
+		stepFor(reset, STEP_NO, resetTrans);
+		check(sameTransforms(fresh, reset), "a second reset moves exactly as a freshly built world", name);
+
+		// The standing tower restored into the other world stays put, as a solver's fork must
+		WorldSnapshot standing;
+		fresh.saveSnapshot(standing);
+		reset.restoreSnapshot(standing);
+		stepFor(reset, STEP_NO/2, resetTrans);
+		double drift = 0;
+		for ( int i = 0; i < fresh.getBlockNo(); i++ )
+			drift += reset.getBlockTransform(i).getOrigin().distance(fresh.getBlockTransform(i).getOrigin());
+		check(drift < DRIFT_LIMIT, "a restored standing tower hardly moves with nothing done to it", name);
+
+		// A recording replays exactly, both on a world not yet built and on the one it was made on
+		InputLog log;
+		reset.startRecording(&log);
+		reset.turnObject(1, 50);
+		stepFor(reset, STEP_NO, resetTrans);
+		reset.stopRecording();
+		PhysicsWorld unbuilt;
+		unbuilt.setBroadphase(type);
+		check(log.replay(unbuilt).match, "a recording replays exactly on a new world", name);
+		check(log.replay(reset).match, "a recording replays exactly on the world it was made on", name);
+
+		fresh.deleteWorld();
+		reset.deleteWorld();
+		unbuilt.deleteWorld();
+	}
+
+	if ( failureNo > 0 )
+		return 1;
+	printf("Passed\n");
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "BlockTowerPhysics.h"
+
+/* Hooks for Bullet's profile zones, adding up the time the calling thread spends
+   moving broadphase proxies and finding overlapping pairs */
+
+#define ZONE_DEPTH 64		// Deepest nesting of zones tracked
+
+// Zones open on the calling thread - only broadphase zones need their start time
+static thread_local bool zoneTimed[ZONE_DEPTH];
+static thread_local std::chrono::steady_clock::time_point zoneStart[ZONE_DEPTH];
+static thread_local int zoneDepth = 0;
+
+static thread_local double broadphaseTime = 0;	// Seconds spent in broadphase zones
+
+
+static bool isBroadphaseZone(const char* name)
+{
+	return !strcmp(name, "updateAabbs") || !strcmp(name, "calculateOverlappingPairs");
+}
+
+
+static void enterZone(const char* name)
+{
+	if ( zoneDepth < ZONE_DEPTH ) {
+		zoneTimed[zoneDepth] = isBroadphaseZone(name);
+		if ( zoneTimed[zoneDepth] )
+			zoneStart[zoneDepth] = std::chrono::steady_clock::now();
+	}
+	zoneDepth++;
+}
+
+
+static void leaveZone()
+{
+	zoneDepth--;
+	if ( zoneDepth >= 0 && zoneDepth < ZONE_DEPTH && zoneTimed[zoneDepth] )
+		broadphaseTime += std::chrono::duration<double>(std::chrono::steady_clock::now()-zoneStart[zoneDepth]).count();
+}
+
+
+void installProfileHooks()
+{
+	/* Route Bullet's profile zones through the timing functions, once per process */
+
+#ifndef BT_NO_PROFILE
+	static std::once_flag installed;
+	std::call_once(installed, []{
+		btSetCustomEnterProfileZoneFunc(enterZone);
+		btSetCustomLeaveProfileZoneFunc(leaveZone);
+	});
+#endif
+}
+
+
+double getThreadBroadphaseTime() { return broadphaseTime; }
\ No newline at end of file
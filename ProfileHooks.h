@@ -0,0 +1,3 @@
+// Hooks for Bullet's profile zones, timing the broadphase part of each step
+void installProfileHooks();
+double getThreadBroadphaseTime();
\ No newline at end of file
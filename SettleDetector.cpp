@@ -0,0 +1,74 @@
+#include "BlockTowerPhysics.h"
+
+SettleDetector::SettleDetector()
+{
+	speedLimit = btScalar(SETTLE_SPEED);
+	energyLimit = btScalar(SETTLE_ENERGY);
+	windowSteps = 6;
+	stillSteps = 0;
+	watching = false;
+	energy = 0;
+	peakSpeed = 0;
+}
+
+
+void SettleDetector::setThresholds(btScalar newSpeedLimit, btScalar newEnergyLimit, int newWindowSteps)
+{
+	/* Set limits within which the tower counts as still, and for how many steps */
+
+	if ( newSpeedLimit > 0 )
+		speedLimit = newSpeedLimit;
+	if ( newEnergyLimit > 0 )
+		energyLimit = newEnergyLimit;
+	if ( newWindowSteps > 0 )
+		windowSteps = newWindowSteps;
+}
+
+
+void SettleDetector::watch(const std::function<void()>& callback)
+{
+	/* Start watching for the tower to settle, replacing any earlier callback */
+
+	onSettled = callback;
+	watching = true;
+	stillSteps = 0;		// Motion before now does not count towards the window
+}
+
+
+void SettleDetector::cancel()
+{
+	/* Stop watching without calling back */
+
+	watching = false;
+	onSettled = nullptr;
+}
+
+
+bool SettleDetector::isWatching() { return watching; }
+btScalar SettleDetector::getEnergy() { return energy; }
+btScalar SettleDetector::getPeakSpeed() { return peakSpeed; }
+
+
+void SettleDetector::addStep(btScalar stepEnergy, btScalar stepPeakSpeed, bool allAsleep)
+{
+	/* Take in the motion after one internal step, calling back if the tower is now at rest */
+
+	energy = stepEnergy;
+	peakSpeed = stepPeakSpeed;
+
+	if ( !watching )
+		return;
+
+	if ( allAsleep || ( peakSpeed <= speedLimit && energy <= energyLimit ) )
+		stillSteps++;
+	else
+		stillSteps = 0;
+
+	// Sleeping islands are certainly at rest, so need not wait out the window
+	if ( allAsleep || stillSteps >= windowSteps ) {
+		std::function<void()> callback = onSettled;
+		cancel();		// Before calling back, so the callback may watch again
+		if ( callback )
+			callback();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+// Watches the tower's motion after each internal step, and reports once it has come to rest.
+// The tower counts as at rest when every island is asleep, or when the peak block speed and
+// kinetic energy per block have stayed within limits for a sliding window of steps.
+class SettleDetector
+{
+	btScalar speedLimit;	// Peak block speed at or below which a step counts as still
+	btScalar energyLimit;	// Kinetic energy per block at or below which a step counts as still
+	int windowSteps;		// Still steps in a row needed before the tower is at rest
+	int stillSteps;			// Still steps in a row seen so far
+
+	bool watching;			// Whether a callback is waiting for the tower to settle
+	std::function<void()> onSettled;	// Called once, from within the step that finds the tower at rest
+
+	btScalar energy;		// Kinetic energy per block after the last step
+	btScalar peakSpeed;		// Fastest block speed after the last step
+
+public:
+	SettleDetector();
+	void setThresholds(btScalar newSpeedLimit, btScalar newEnergyLimit, int newWindowSteps);
+	void watch(const std::function<void()>& callback);
+	void cancel();
+	bool isWatching();
+	void addStep(btScalar stepEnergy, btScalar stepPeakSpeed, bool allAsleep);
+	btScalar getEnergy();
+	btScalar getPeakSpeed();
+};
\ No newline at end of file
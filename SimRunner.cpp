@@ -0,0 +1,920 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "BlockTowerTools.h"
+
+/* Headless simulation runner - steps the tower with scripted input and reports throughput */
+
+// Run settings, adjustable from the command line
+int frameNo = 5000;			// Number of frames to simulate
+int stepRate = 120;			// Internal physics steps per second
+unsigned int seed = 1;		// Seed for random block shapes
+int blockNo = BLOCK_NO;		// Number of blocks in the tower
+int layerWidth = LAYER_WIDTH;	// Number of blocks in each layer
+int worldNo = 0;			// Number of worlds for batched run (0 = single world run)
+int threadNo = 0;			// Threads for batched run (0 = all cores)
+bool scaling = false;		// Whether to compare towers of increasing size
+bool kernels = false;		// Whether to compare scalar and batch tower checks
+bool collapse = false;		// Whether to compare physics threads through a collapse
+bool settling = false;		// Whether to time how long a placement takes to validate
+bool broadphases = false;	// Whether to compare broadphases across scenarios
+bool picking = false;		// Whether to time picking blocks with rays
+bool games = false;			// Whether to play whole games with a bot
+bool solving = false;		// Whether to rank moves with the solver and play a game with it
+double solveBudget = 0.5;	// Seconds the solver has for each move
+bool stability = false;		// Whether to check predicted stability against simulating removals
+const char* recordPath = 0;	// File to record the single world run to (0 for none)
+const char* replayPath = 0;	// Recording to replay instead of running the scripted input
+
+PhysicsWorld physWorld;		// Physics simulation object
+btTransform* boxTrans = 0;	// Array for transformations of blocks in the physics world
+
+
+double percentile(std::vector<double>& samples, double fraction)
+{
+	/* Get value below which the given fraction of sorted samples lie */
+
+	if ( samples.empty() )
+		return 0;
+
+	size_t index = size_t(fraction*(samples.size()-1)+0.5);
+	return samples[std::min(index, samples.size()-1)];
+}
+
+
+void buildTower(int newBlockNo, int newLayerWidth)
+{
+	/* Create world with a tower of the given size */
+
+	physWorld.setSeed(seed);
+	physWorld.setStepRate(stepRate);
+	physWorld.setTowerSize(newBlockNo, newLayerWidth);
+	physWorld.createWorld();
+
+	delete[] boxTrans;
+	boxTrans = new btTransform[physWorld.getBlockNo()];
+	physWorld.advanceWorld(0, boxTrans);
+}
+
+
+bool towerChecks(double towerHeight)
+{
+	/* Make the same per-block checks as display() does each frame, without drawing */
+
+	bool towerStanding = false;
+	bool blockFallen = false;
+	bool towerActive = false;
+
+	for ( int i=0; i<physWorld.getBlockNo(); i++ ) {
+		if ( boxTrans[i].getOrigin().getY() > towerHeight-1.52 && !towerStanding )
+			if ( physWorld.checkContact(i) )
+				towerStanding = true;
+		if ( !physWorld.isActive(i) && !blockFallen )
+			if ( !physWorld.checkContact(i) )
+				blockFallen = true;
+		if ( boxTrans[i].getOrigin().getX() > H_SPAN*1.1 || boxTrans[i].getOrigin().getZ() > H_SPAN*1.1 )
+			physWorld.centerObject(i);
+		if ( physWorld.isActive(i) )
+			towerActive = true;
+	}
+
+	return towerStanding && !blockFallen && !towerActive;
+}
+
+
+bool batchChecks(double towerHeight)
+{
+	/* Make the same checks as towerChecks, using the batch kernels over the whole tower */
+
+	TowerCheck check = physWorld.checkTower(towerHeight-1.52, -1);
+	physWorld.recenterBlocks(H_SPAN*1.1);
+
+	return check.standing && !check.fallen && !check.active;
+}
+
+
+void scriptedInput(int frame)
+{
+	/* Apply the same pushes and drags a player would, on a fixed schedule */
+
+	// Every second of simulated time, push a block from one of the lower layers
+	if ( frame%stepRate == stepRate/2 ) {
+		int objectIndex = (frame/stepRate*7)%(blockNo/2);
+		btVector3 boxOrigin = boxTrans[objectIndex].getOrigin();
+		double mouseRay[3] = { boxOrigin.getX()+1, boxOrigin.getY(), boxOrigin.getZ()+1 };
+		physWorld.pushObject(objectIndex, (frame/stepRate)%2 ? 15 : -15, mouseRay);
+	}
+
+	// Every four seconds, drag a block sideways out of the tower for half a second
+	int dragFrame = frame%(stepRate*4);
+	int dragIndex = (frame/(stepRate*4)*5+1)%(blockNo/2);
+	if ( dragFrame < stepRate/2 ) {
+		btVector3 boxOrigin = boxTrans[dragIndex].getOrigin();
+		double mouseRay[3] = { boxOrigin.getX()+2, boxOrigin.getY(), boxOrigin.getZ() };
+		double objectSelect[3] = { 0, 0, 0 };
+		physWorld.dragObject(dragIndex, mouseRay, objectSelect);
+	}
+	else if ( dragFrame == stepRate/2 )
+		physWorld.stopObject(dragIndex);
+}
+
+
+int runBatched()
+{
+	/* Step a batch of independent worlds in parallel and report environment throughput */
+
+	TowerEnv env(worldNo, threadNo, seed, stepRate, blockNo, layerWidth);
+	float* actions = env.getActions();
+
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	for ( int frame=0; frame<frameNo; frame++ ) {
+		// Every second of simulated time, push a lower block in every world
+		if ( frame%stepRate == stepRate/2 ) {
+			const float* observations = env.getObservations();
+			for ( int w=0; w<worldNo; w++ ) {
+				int objectIndex = (frame/stepRate*7+w)%(blockNo/2);
+				const float* observation = &observations[(w*blockNo+objectIndex)*TOWER_OBSERVATION_SIZE];
+				float* action = &actions[w*TOWER_ACTION_SIZE];
+				action[0] = TOWER_ACTION_PUSH;
+				action[1] = float(objectIndex);
+				action[2] = (frame/stepRate)%2 ? 15.0f : -15.0f;
+				action[3] = observation[0]+1;
+				action[4] = observation[1];
+				action[5] = observation[2]+1;
+			}
+		}
+		env.step(1);
+	}
+	double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-runStart).count();
+
+	printf("Worlds:        %d\n", worldNo);
+	printf("Threads:       %d\n", threadNo > 0 ? threadNo : int(std::max(1u, std::thread::hardware_concurrency())));
+	printf("Frames:        %d\n", frameNo);
+	printf("Wall time:     %.3f s\n", runTime);
+	printf("Env steps/sec: %.1f\n", double(worldNo)*frameNo/runTime);
+
+	return 0;
+}
+
+
+int runScaling()
+{
+	/* Compare step and per-frame check cost for towers of increasing size */
+
+	const int sizes[] = { 54, 500, 2000, 5000 };
+
+	printf("Blocks  Width  Step p50 (us)  Step mean (us)  Checks mean (us)  Frame mean (us)\n");
+
+	for ( int s=0; s<4; s++ ) {
+		// Widen layers as the tower grows, so that it stays about as wide as it is tall
+		blockNo = sizes[s];
+		layerWidth = std::max(LAYER_WIDTH, int(sqrt(blockNo/4.0)));
+		buildTower(blockNo, layerWidth);
+		double towerHeight = floor(double(blockNo)/layerWidth)*1.52;
+
+		std::vector<double> stepLatency;
+		double stepTotal = 0;
+		double checkTotal = 0;
+
+		for ( int frame=0; frame<frameNo; frame++ ) {
+			scriptedInput(frame);
+
+			std::chrono::steady_clock::time_point stepStart = std::chrono::steady_clock::now();
+			physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+			std::chrono::steady_clock::time_point checkStart = std::chrono::steady_clock::now();
+			batchChecks(towerHeight);
+			std::chrono::steady_clock::time_point checkEnd = std::chrono::steady_clock::now();
+
+			double stepTime = std::chrono::duration<double, std::micro>(checkStart-stepStart).count();
+			stepLatency.push_back(stepTime);
+			stepTotal += stepTime;
+			checkTotal += std::chrono::duration<double, std::micro>(checkEnd-checkStart).count();
+		}
+		std::sort(stepLatency.begin(), stepLatency.end());
+
+		printf("%6d  %5d  %13.1f  %14.1f  %16.2f  %15.1f\n",
+			blockNo, layerWidth,
+			percentile(stepLatency, 0.5),
+			stepTotal/frameNo,
+			checkTotal/frameNo,
+			(stepTotal+checkTotal)/frameNo
+		);
+
+		physWorld.deleteWorld();
+	}
+
+	return 0;
+}
+
+
+int runKernels()
+{
+	/* Time the per-frame tower checks block by block and with the batch kernels */
+
+	const int sizes[] = { 54, 500, 2000, 5000, 20000 };
+
+	printf("Blocks  Scalar (us)  Batch (us)  Speedup  Match\n");
+
+	for ( int s=0; s<5; s++ ) {
+		blockNo = sizes[s];
+		layerWidth = std::max(LAYER_WIDTH, int(sqrt(blockNo/4.0)));
+		buildTower(blockNo, layerWidth);
+		double towerHeight = floor(double(blockNo)/layerWidth)*1.52;
+
+		// Let the tower settle a little, so that some blocks are asleep and contacts exist
+		for ( int frame=0; frame<stepRate; frame++ )
+			physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+
+		// Both versions are timed over the same state, and must agree on it
+		bool scalarResult = false;
+		bool batchResult = false;
+
+		std::chrono::steady_clock::time_point scalarStart = std::chrono::steady_clock::now();
+		for ( int i=0; i<frameNo; i++ )
+			scalarResult = towerChecks(towerHeight);
+		std::chrono::steady_clock::time_point batchStart = std::chrono::steady_clock::now();
+		for ( int i=0; i<frameNo; i++ )
+			batchResult = batchChecks(towerHeight);
+		std::chrono::steady_clock::time_point batchEnd = std::chrono::steady_clock::now();
+
+		double scalarTime = std::chrono::duration<double, std::micro>(batchStart-scalarStart).count()/frameNo;
+		double batchTime = std::chrono::duration<double, std::micro>(batchEnd-batchStart).count()/frameNo;
+
+		printf("%6d  %11.2f  %10.2f  %6.1fx  %5s\n",
+			blockNo, scalarTime, batchTime,
+			batchTime > 0 ? scalarTime/batchTime : 0.0,
+			scalarResult == batchResult ? "yes" : "NO"
+		);
+
+		physWorld.deleteWorld();
+	}
+
+	return 0;
+}
+
+
+void collapseInput(int frame)
+{
+	/* Drag every block of the bottom layer out lengthways for the first half second, bringing the tower down */
+
+	for ( int i=0; i<layerWidth; i++ ) {
+		if ( frame < stepRate/2 ) {
+			btVector3 boxOrigin = boxTrans[i].getOrigin();
+			double mouseRay[3] = { boxOrigin.getX()+( i%2 ? 3 : -3 )*layerWidth, boxOrigin.getY(), boxOrigin.getZ() };
+			double objectSelect[3] = { 0, 0, 0 };
+			physWorld.dragObject(i, mouseRay, objectSelect);
+		}
+		else if ( frame == stepRate/2 )
+			physWorld.stopObject(i);
+	}
+}
+
+
+void collapseRun(const char* pipeline, int physicsThreadNo, bool deterministic)
+{
+	/* Knock out the bottom layer and time every step while the tower comes down */
+
+	if ( physicsThreadNo > 0 ) {
+		if ( !setPhysicsThreads(physicsThreadNo) ) {
+			printf("%-14s  %7d  (Bullet built without thread support)\n", pipeline, physicsThreadNo);
+			return;
+		}
+		physWorld.setThreading(true, deterministic);
+	}
+	else
+		physWorld.setThreading(false, true);
+	buildTower(blockNo, layerWidth);
+
+	std::vector<double> stepLatency;
+	stepLatency.reserve(frameNo);
+	double stepTotal = 0;
+	unsigned long steadyAllocations = 0;	// Bullet heap allocations after the first second, by any thread
+
+	for ( int frame=0; frame<frameNo; frame++ ) {
+		collapseInput(frame);
+
+		std::chrono::steady_clock::time_point stepStart = std::chrono::steady_clock::now();
+		physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+		double stepTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()-stepStart).count();
+
+		stepLatency.push_back(stepTime);
+		stepTotal += stepTime;
+		if ( frame >= stepRate )
+			steadyAllocations += physWorld.getStepAllocations().allocations;
+	}
+	std::sort(stepLatency.begin(), stepLatency.end());
+
+	// Deterministic runs must end with the same positions, whatever the thread count
+	double checksum = 0;
+	for ( int i=0; i<blockNo; i++ )
+		checksum += boxTrans[i].getOrigin().getX()+boxTrans[i].getOrigin().getY()+boxTrans[i].getOrigin().getZ();
+
+	printf("%-14s  %7d  %14.1f  %8.1f  %8.1f  %11lu  %14.6f\n",
+		pipeline, std::max(1, physicsThreadNo),
+		stepTotal/frameNo,
+		percentile(stepLatency, 0.50),
+		percentile(stepLatency, 0.99),
+		steadyAllocations,
+		checksum
+	);
+
+	physWorld.deleteWorld();
+}
+
+
+int runCollapse()
+{
+	/* Compare step time through a scripted collapse on the single-threaded and multithreaded pipelines */
+
+	const int threadCounts[] = { 1, 2, 4, 8 };
+
+	printf("Blocks: %d (%d per layer), frames: %d\n", blockNo, layerWidth, frameNo);
+	printf("Pipeline        Threads  Step mean (us)  p50 (us)  p99 (us)  Allocations  Final checksum\n");
+
+	collapseRun("serial", 0, true);
+	for ( int t=0; t<4; t++ )
+		collapseRun("mt-determ", threadCounts[t], true);
+	for ( int t=0; t<4; t++ )
+		collapseRun("mt-free", threadCounts[t], false);
+
+	return 0;
+}
+
+
+int runSettle()
+{
+	/* Drop the top block back onto the tower, and compare when the settle detector
+	   reports it at rest with when Bullet has put every block to sleep */
+
+	buildTower(blockNo, layerWidth);
+	for ( int frame=0; frame<stepRate; frame++ )
+		physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+
+	// Lift the top block a little, as a player placing it would, then let go
+	int topIndex = blockNo-1;
+	double dropHeight = boxTrans[topIndex].getOrigin().getY()+1;
+	for ( int frame=0; frame<stepRate/4; frame++ ) {
+		physWorld.raiseObjectTo(topIndex, dropHeight);
+		physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+	}
+	physWorld.stopObject(topIndex);
+
+	int frame = 0;
+	int settledFrame = -1;		// Frame at which the settle detector called back
+	int asleepFrame = -1;		// Frame at which no block was active any more
+	physWorld.watchSettle([&]() { settledFrame = frame; });
+
+	for ( frame=0; frame<frameNo && ( settledFrame < 0 || asleepFrame < 0 ); frame++ ) {
+		physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+		if ( asleepFrame < 0 && !physWorld.isTowerActive() )
+			asleepFrame = frame;
+	}
+
+	printf("Blocks:        %d (%d per layer)\n", blockNo, layerWidth);
+	if ( settledFrame >= 0 )
+		printf("Settled after: %.0f ms of sim time\n", 1000.0*(settledFrame+1)/stepRate);
+	else
+		printf("Settled after: not within %d frames\n", frameNo);
+	if ( asleepFrame >= 0 )
+		printf("Asleep after:  %.0f ms of sim time\n", 1000.0*(asleepFrame+1)/stepRate);
+	else
+		printf("Asleep after:  not within %d frames\n", frameNo);
+
+	physWorld.deleteWorld();
+
+	return 0;
+}
+
+
+int runReplay()
+{
+	/* Re-run a recorded session as fast as possible and check it ends where the recording did */
+
+	InputLog log;
+	if ( !log.load(replayPath) ) {
+		printf("Could not read recording %s\n", replayPath);
+		return 1;
+	}
+
+	ReplayResult result = log.replay(physWorld);
+
+	printf("Recording:     %s\n", replayPath);
+	printf("Blocks:        %d (%d per layer)\n", physWorld.getBlockNo(), physWorld.getLayerWidth());
+	printf("Events:        %d\n", log.getEventNo());
+	printf("Steps:         %lu\n", result.stepNo);
+	printf("Wall time:     %.3f s\n", result.wallTime);
+	printf("Steps/sec:     %.1f\n", result.wallTime > 0 ? result.stepNo/result.wallTime : 0.0);
+	printf("Step indices:  %s\n", result.inStep ? "match" : "DIFFER");
+	printf("Final state:   %s (max position error %g)\n", result.match ? "match" : "DIFFERS", double(result.maxError));
+
+	physWorld.deleteWorld();
+
+	return result.match && result.inStep ? 0 : 2;
+}
+
+
+int runBroadphases()
+{
+	/* Compare pair update cost and step time of each broadphase, for a resting tower,
+	   a tower being pushed and dragged, and a collapsing tower */
+
+	const int sizes[] = { 54, 500, 2000 };
+	const int types[] = { BROADPHASE_DBVT, BROADPHASE_SWEEP, BROADPHASE_SIMPLE };
+	const char* typeNames[] = { "dbvt", "sweep", "simple" };
+	const char* scenarioNames[] = { "rest", "drag", "collapse" };
+
+	printf("Broadphase  Scenario  Blocks  Pairs mean (us)  Step mean (us)  Pair share\n");
+
+	for ( int s=0; s<3; s++ ) {
+		blockNo = sizes[s];
+		layerWidth = std::max(LAYER_WIDTH, int(sqrt(blockNo/4.0)));
+
+		for ( int scenario=0; scenario<3; scenario++ ) {
+			for ( int t=0; t<3; t++ ) {
+				physWorld.setBroadphase(types[t]);
+				buildTower(blockNo, layerWidth);
+
+				double pairTotal = 0;
+				double stepTotal = 0;
+				for ( int frame=0; frame<frameNo; frame++ ) {
+					if ( scenario == 1 )
+						scriptedInput(frame);
+					else if ( scenario == 2 )
+						collapseInput(frame);
+
+					std::chrono::steady_clock::time_point stepStart = std::chrono::steady_clock::now();
+					physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+					stepTotal += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()-stepStart).count();
+					pairTotal += physWorld.getStepBroadphaseTime()*1e6;
+				}
+
+				printf("%-10s  %-8s  %6d  %15.1f  %14.1f  %9.0f%%\n",
+					typeNames[t], scenarioNames[scenario], blockNo,
+					pairTotal/frameNo,
+					stepTotal/frameNo,
+					stepTotal > 0 ? 100*pairTotal/stepTotal : 0.0
+				);
+
+				physWorld.deleteWorld();
+			}
+		}
+	}
+	physWorld.setBroadphase(BROADPHASE_DBVT);
+
+	return 0;
+}
+
+
+int runPicking()
+{
+	/* Time the CPU side of picking only: casting rays through Bullet, against finding the block
+	   at a known point as the depth readback path does once it has read the pixel back. The
+	   readback's own stall is timed by the headless build's picking stage, with --readback-picking. */
+
+	const int sizes[] = { 54, 500, 2000, 5000 };
+
+	printf("CPU cost of picking - see the headless build for the depth readback itself\n");
+	printf("Blocks  Ray cast (us)  Point lookup (us)  Agree\n");
+
+	for ( int s=0; s<4; s++ ) {
+		blockNo = sizes[s];
+		layerWidth = std::max(LAYER_WIDTH, int(sqrt(blockNo/4.0)));
+		buildTower(blockNo, layerWidth);
+		for ( int frame=0; frame<stepRate; frame++ )
+			physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+		double towerHeight = floor(double(blockNo)/layerWidth)*1.52;
+
+		// Rays from a camera circling the tower, aimed at points spread over it
+		std::minstd_rand rayRandom(seed);
+		std::uniform_real_distribution<btScalar> unit(0, 1);
+		std::vector<btVector3> rayFrom(frameNo), rayTo(frameNo);
+		for ( int i=0; i<frameNo; i++ ) {
+			btScalar angle = btScalar(2*PI)*unit(rayRandom);
+			btScalar spread = btScalar(2.5*layerWidth);
+			btVector3 eye(45*btCos(angle), btScalar(towerHeight/2+10), 45*btSin(angle));
+			btVector3 target(spread*(unit(rayRandom)-0.5f), btScalar(towerHeight)*unit(rayRandom), spread*(unit(rayRandom)-0.5f));
+			rayFrom[i] = eye;
+			rayTo[i] = eye+(target-eye)*5;
+		}
+
+		std::vector<int> castIndex(frameNo);
+		std::vector<btVector3> hitPoint(frameNo);
+		std::chrono::steady_clock::time_point castStart = std::chrono::steady_clock::now();
+		for ( int i=0; i<frameNo; i++ )
+			physWorld.castRay(rayFrom[i], rayTo[i], castIndex[i], hitPoint[i]);
+		std::chrono::steady_clock::time_point lookupStart = std::chrono::steady_clock::now();
+		int agree = 0;
+		for ( int i=0; i<frameNo; i++ ) {
+			double point[3] = { hitPoint[i].getX(), hitPoint[i].getY(), hitPoint[i].getZ() };
+			if ( physWorld.findObjectAt(point) == castIndex[i] )
+				agree++;
+		}
+		std::chrono::steady_clock::time_point lookupEnd = std::chrono::steady_clock::now();
+
+		printf("%6d  %13.2f  %17.2f  %4.0f%%\n",
+			blockNo,
+			std::chrono::duration<double, std::micro>(lookupStart-castStart).count()/frameNo,
+			std::chrono::duration<double, std::micro>(lookupEnd-lookupStart).count()/frameNo,
+			100.0*agree/frameNo
+		);
+
+		physWorld.deleteWorld();
+	}
+
+	return 0;
+}
+
+
+int runGames()
+{
+	/* Play whole games through a game session at full speed, with a bot for a player */
+
+	buildTower(blockNo, layerWidth);
+	GameSession session;
+	session.start(&physWorld);
+
+	GameBot bot(&physWorld, BOT_RANDOM, seed);
+	GameInput input;
+	unsigned long gameNo = session.getState().gameNo;
+	int finishedGameNo = 0;
+	long turnTotal = 0;
+	int lastTurnNo = 0;
+
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	for ( int frame=0; frame<frameNo; frame++ ) {
+		const GameState& state = session.getState();
+		if ( state.gameNo != gameNo ) {
+			// The last tick started a new game
+			gameNo = state.gameNo;
+			finishedGameNo++;
+			turnTotal += lastTurnNo;
+		}
+		lastTurnNo = state.turnNo;
+
+		bot.play(state, session.getTransforms(), input);
+		session.tick(1.0/stepRate, input);
+	}
+	double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-runStart).count();
+
+	printf("Blocks:        %d (%d per layer)\n", blockNo, layerWidth);
+	printf("Game time:     %.1f s in %.3f s wall time (%.0fx real time)\n",
+		double(frameNo)/stepRate, runTime, frameNo/(stepRate*runTime));
+	printf("Games:         %d finished (%.2f games/sec)\n", finishedGameNo, finishedGameNo/runTime);
+	if ( finishedGameNo > 0 )
+		printf("Turns:         %.1f per game, best %d\n", double(turnTotal)/finishedGameNo, session.getState().maxTurnNo);
+	printf("Current game:  turn %d, phase %d\n", session.getState().turnNo, session.getState().phase);
+
+	physWorld.deleteWorld();
+
+	return 0;
+}
+
+
+int runSolve()
+{
+	/* Rank every move on a settled tower with growing numbers of threads, then play a game
+	   with the solver choosing each move, as an estimate of the best score for the seed */
+
+	buildTower(blockNo, layerWidth);
+	for ( int frame=0; frame<stepRate; frame++ )
+		physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+	double towerHeight = floor(double(blockNo)/layerWidth)*LAYER_HEIGHT;
+
+	WorldSnapshot root;
+	physWorld.saveSnapshot(root);
+	std::vector<SolverMove> moves;
+
+	// Simulate every candidate each time, so the rates compare like for like
+	int maxThreadNo = threadNo > 0 ? threadNo : int(std::max(1u, std::thread::hardware_concurrency()));
+	double baseRate = 0;
+	printf("Threads  Candidates  Wall (s)  Candidates/sec  Speedup\n");
+	for ( int t=1; ; t=std::min(t*2, maxThreadNo) ) {
+		TowerSolver solver(t, stepRate, blockNo, layerWidth);
+		std::chrono::steady_clock::time_point solveStart = std::chrono::steady_clock::now();
+		int evaluatedNo = solver.solve(root, towerHeight, 0, moves);
+		double solveTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-solveStart).count();
+		if ( t == 1 ) {
+			baseRate = solver.getRate();
+
+			// Candidates are only worth ranking if a fork left alone stays where the tower was
+			double drift = solver.measureDrift(root);
+			if ( drift > SOLVER_DRIFT_LIMIT ) {
+				printf("A restored fork moved %.3f in total with no move made - not ranking moves\n", drift);
+				physWorld.deleteWorld();
+				return 1;
+			}
+		}
+
+		printf("%7d  %10d  %8.3f  %14.1f  %6.2fx\n",
+			t, evaluatedNo, solveTime, solver.getRate(), baseRate > 0 ? solver.getRate()/baseRate : 0);
+		if ( t == maxThreadNo )
+			break;
+	}
+
+	printf("\nBest moves:\n");
+	printf("Block  Place at                 Score  Moved  Settle (s)\n");
+	for ( size_t m=0; m<moves.size() && m<5; m++ ) {
+		const SolverMove& move = moves[m];
+		printf("%5d  (%5.2f, %5.2f, %5.2f)  %8.2f  %5.2f  %10.2f%s\n",
+			move.objectIndex, move.placeOrigin.getX(), move.placeOrigin.getY(), move.placeOrigin.getZ(),
+			move.score, move.displacement, move.settleTime,
+			move.collapsed ? " collapsed" : ( move.valid ? "" : " invalid" ));
+	}
+
+	// Play the game out, taking the solver's best move each turn
+	printf("\n");
+	TowerSolver solver(threadNo, stepRate, blockNo, layerWidth);
+	int turnNo = 0;
+	for ( ;; ) {
+		physWorld.saveSnapshot(root);
+		std::chrono::steady_clock::time_point solveStart = std::chrono::steady_clock::now();
+		int evaluatedNo = solver.solve(root, towerHeight, solveBudget, moves);
+		double solveTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-solveStart).count();
+		if ( evaluatedNo == 0 || moves[0].score <= SOLVER_FAILED )
+			break;		// Nothing left that keeps the tower up
+
+		SolverMove move = moves[0];
+		physWorld.restoreSnapshot(root);	// As the forks started from it
+		solver.playMove(physWorld, move, towerHeight);
+		printf("Turn %3d: block %2d, %4d of %4d candidates in %4.0f ms, score %7.2f%s\n",
+			turnNo+1, move.objectIndex, evaluatedNo, int(moves.size()), solveTime, move.score,
+			move.collapsed ? " - collapsed" : ( move.valid ? "" : " - invalid" ));
+		if ( move.collapsed || !move.valid )
+			break;
+
+		turnNo++;
+		if ( (turnNo+blockNo)%layerWidth == 0 )
+			towerHeight += LAYER_HEIGHT;
+	}
+	printf("Seed %u: %d turns (score %d) with %.0f ms per move on %d threads\n",
+		seed, turnNo, std::min(turnNo, turnNo+blockNo-STANDARD_BLOCK_NO), solveBudget*1000, solver.getThreadNo());
+
+	physWorld.deleteWorld();
+
+	return 0;
+}
+
+
+int runStability()
+{
+	/* Predict whether the tower stands with each block, and each pair of blocks in a layer,
+	   taken out, then simulate each removal to see how often and how fast the predictor is right */
+
+	buildTower(blockNo, layerWidth);
+	for ( int frame=0; frame<stepRate; frame++ )
+		physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+	double towerHeight = floor(double(blockNo)/layerWidth)*LAYER_HEIGHT;
+
+	WorldSnapshot root;
+	physWorld.saveSnapshot(root);
+	StabilityPredictor predictor;
+	predictor.capture(physWorld);
+
+	// Blocks below the top complete layer, as the game allows, singly and in pairs from a layer
+	std::vector<std::vector<int> > candidates;
+	std::vector<int> layers(blockNo);
+	for ( int i=0; i<blockNo; i++ ) {
+		btScalar y = boxTrans[i].getOrigin().getY();
+		layers[i] = int(floor((y-0.75)/1.5+0.5));
+		if ( y < towerHeight-LAYER_HEIGHT )
+			candidates.push_back(std::vector<int>(1, i));
+	}
+	size_t singleNo = candidates.size();
+	for ( size_t a=0; a<singleNo; a++ ) {
+		for ( size_t b=a+1; b<singleNo; b++ ) {
+			int first = candidates[a][0];
+			int second = candidates[b][0];
+			if ( layers[first] == layers[second] ) {
+				std::vector<int> pair(1, first);
+				pair.push_back(second);
+				candidates.push_back(pair);
+			}
+		}
+	}
+
+	std::vector<btTransform> start(blockNo);
+	for ( int i=0; i<blockNo; i++ )
+		start[i] = boxTrans[i];
+
+	// Simulated outcomes only mean something if the restored tower stands still with nothing taken out
+	physWorld.restoreSnapshot(root);
+	for ( int frame=0; frame<2*stepRate; frame++ )
+		physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+	double baseDrift = 0;
+	for ( int i=0; i<blockNo; i++ )
+		baseDrift = std::max(baseDrift, double(boxTrans[i].getOrigin().distance(start[i].getOrigin())));
+	if ( baseDrift > 0.05 ) {
+		printf("The restored tower moved up to %.3f with nothing taken out - not reporting accuracy\n", baseDrift);
+		physWorld.deleteWorld();
+		return 1;
+	}
+
+	int verdicts[2][2] = { { 0, 0 }, { 0, 0 } };	// Counts by predicted, then simulated, standing
+	double predictTime = 0;
+	double simulateTime = 0;
+	double rowSum = 0, columnSum = 0, pivotSum = 0;
+	const int repeatNo = 100;	// Predictions are too quick to time one at a time
+	for ( size_t c=0; c<candidates.size(); c++ ) {
+		const std::vector<int>& removed = candidates[c];
+
+		bool predicted = false;
+		std::chrono::steady_clock::time_point predictStart = std::chrono::steady_clock::now();
+		for ( int r=0; r<repeatNo; r++ )
+			predicted = predictor.predict(removed.data(), int(removed.size()));
+		predictTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()-predictStart).count()/repeatNo;
+		rowSum += predictor.getRowNo();
+		columnSum += predictor.getColumnNo();
+		pivotSum += predictor.getPivotNo();
+
+		// Take the blocks clean away, out on the floor, and let the tower do what it will
+		std::chrono::steady_clock::time_point simulateStart = std::chrono::steady_clock::now();
+		physWorld.restoreSnapshot(root);
+		for ( size_t k=0; k<removed.size(); k++ )
+			physWorld.placeObject(removed[k], btVector3(btScalar(40+3*k), btScalar(0.75), 0), 0);
+		for ( int frame=0; frame<2*stepRate; frame++ )
+			physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+		simulateTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()-simulateStart).count();
+
+		bool standing = true;
+		for ( int i=0; i<blockNo && standing; i++ ) {
+			if ( std::find(removed.begin(), removed.end(), i) == removed.end() )
+				standing = boxTrans[i].getOrigin().distance(start[i].getOrigin()) < 0.5;
+		}
+		verdicts[predicted ? 1 : 0][standing ? 1 : 0]++;
+	}
+
+	int candidateNo = int(candidates.size());
+	int correctNo = verdicts[0][0]+verdicts[1][1];
+	printf("Blocks:        %d (%d per layer)\n", blockNo, layerWidth);
+	printf("Candidates:    %d (%d single, %d pairs)\n", candidateNo, int(singleNo), candidateNo-int(singleNo));
+	printf("Baseline:      blocks moved at most %.4f in 2 s with nothing taken out\n", baseDrift);
+	printf("                  Simulated standing  Simulated falling\n");
+	printf("Predicted stable  %18d  %17d\n", verdicts[1][1], verdicts[1][0]);
+	printf("Predicted falls   %18d  %17d\n", verdicts[0][1], verdicts[0][0]);
+	printf("Accuracy:      %.1f%% (%d of %d)\n", candidateNo > 0 ? 100.0*correctNo/candidateNo : 0, correctNo, candidateNo);
+	if ( candidateNo > 0 ) {
+		printf("Predict:       %.2f us (%.1f rows, %.1f columns, %.1f pivots on average)\n",
+			predictTime/candidateNo, rowSum/candidateNo, columnSum/candidateNo, pivotSum/candidateNo);
+		printf("Simulate:      %.0f us for 2 s of sim time\n", simulateTime/candidateNo);
+		printf("Speedup:       %.0fx\n", predictTime > 0 ? simulateTime/predictTime : 0);
+	}
+
+	physWorld.deleteWorld();
+
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	/* Read settings from command line */
+
+	for ( int i=1; i<argc; i++ ) {
+		if ( !strcmp(argv[i], "--frames") && i+1 < argc )
+			frameNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--rate") && i+1 < argc )
+			stepRate = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--seed") && i+1 < argc )
+			seed = (unsigned int)atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--blocks") && i+1 < argc )
+			blockNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--width") && i+1 < argc )
+			layerWidth = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--scale") )
+			scaling = true;
+		else if ( !strcmp(argv[i], "--kernels") )
+			kernels = true;
+		else if ( !strcmp(argv[i], "--collapse") )
+			collapse = true;
+		else if ( !strcmp(argv[i], "--settle") )
+			settling = true;
+		else if ( !strcmp(argv[i], "--broadphase") )
+			broadphases = true;
+		else if ( !strcmp(argv[i], "--picking") )
+			picking = true;
+		else if ( !strcmp(argv[i], "--games") )
+			games = true;
+		else if ( !strcmp(argv[i], "--solve") )
+			solving = true;
+		else if ( !strcmp(argv[i], "--budget") && i+1 < argc )
+			solveBudget = atof(argv[++i])/1000;
+		else if ( !strcmp(argv[i], "--stability") )
+			stability = true;
+		else if ( !strcmp(argv[i], "--record") && i+1 < argc )
+			recordPath = argv[++i];
+		else if ( !strcmp(argv[i], "--replay") && i+1 < argc )
+			replayPath = argv[++i];
+		else if ( !strcmp(argv[i], "--worlds") && i+1 < argc )
+			worldNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--threads") && i+1 < argc )
+			threadNo = atoi(argv[++i]);
+		else {
+			printf("Usage: %s [--frames N] [--rate HZ] [--seed S] [--blocks N] [--width W] [--scale] [--kernels] [--collapse] [--settle] [--broadphase] [--picking] [--games] [--solve [--budget MS]] [--stability] [--record FILE] [--replay FILE] [--worlds K [--threads T]]\n", argv[0]);
+			return 1;
+		}
+	}
+	if ( frameNo <= 0 || stepRate <= 0 || blockNo <= 0 || layerWidth <= 0 ) {
+		printf("Frame count, step rate, block count and layer width must be positive\n");
+		return 1;
+	}
+
+	if ( replayPath )
+		return runReplay();
+	if ( scaling )
+		return runScaling();
+	if ( kernels )
+		return runKernels();
+	if ( collapse )
+		return runCollapse();
+	if ( settling )
+		return runSettle();
+	if ( broadphases )
+		return runBroadphases();
+	if ( picking )
+		return runPicking();
+	if ( games )
+		return runGames();
+	if ( solving )
+		return runSolve();
+	if ( stability )
+		return runStability();
+	if ( worldNo > 0 )
+		return runBatched();
+
+	/* Build the tower */
+
+	buildTower(blockNo, layerWidth);
+
+	InputLog log;
+	if ( recordPath )
+		physWorld.startRecording(&log);
+
+	/* Step the world one internal step per frame, timing each step */
+
+	std::vector<double> stepLatency;	// Time taken by each internal step, in microseconds
+	stepLatency.reserve(frameNo);
+
+	// Bullet heap allocations during the first second of steps, and during all later steps
+	AllocationCount warmUpAllocations = { 0, 0 };
+	AllocationCount steadyAllocations = { 0, 0 };
+
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	for ( int frame=0; frame<frameNo; frame++ ) {
+		scriptedInput(frame);
+
+		std::chrono::steady_clock::time_point stepStart = std::chrono::steady_clock::now();
+		int subSteps = physWorld.advanceWorld(btScalar(1.0/stepRate), boxTrans);
+		std::chrono::steady_clock::time_point stepEnd = std::chrono::steady_clock::now();
+
+		if ( subSteps > 0 )
+			stepLatency.push_back(std::chrono::duration<double, std::micro>(stepEnd-stepStart).count()/subSteps);
+
+		AllocationCount& allocations = frame < stepRate ? warmUpAllocations : steadyAllocations;
+		allocations.allocations += physWorld.getStepAllocations().allocations;
+		allocations.bytes += physWorld.getStepAllocations().bytes;
+	}
+	double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-runStart).count();
+
+	/* Report results */
+
+	std::sort(stepLatency.begin(), stepLatency.end());
+
+	printf("Blocks:        %d (%d per layer)\n", blockNo, layerWidth);
+	printf("Frames:        %d\n", frameNo);
+	printf("Steps:         %lu (%d dropped)\n", physWorld.getStepCount(), physWorld.getDroppedSubSteps());
+	printf("Wall time:     %.3f s\n", runTime);
+	printf("Steps/sec:     %.1f\n", physWorld.getStepCount()/runTime);
+	printf("Step latency:  p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+		percentile(stepLatency, 0.50),
+		percentile(stepLatency, 0.90),
+		percentile(stepLatency, 0.99),
+		percentile(stepLatency, 1.00)
+	);
+
+	printf("Allocations:   %lu (%lu bytes) in first second, %lu (%lu bytes) after\n",
+		warmUpAllocations.allocations, warmUpAllocations.bytes,
+		steadyAllocations.allocations, steadyAllocations.bytes
+	);
+
+	if ( recordPath ) {
+		physWorld.stopRecording();
+		if ( log.save(recordPath) )
+			printf("Recorded:      %d events to %s\n", log.getEventNo(), recordPath);
+		else
+			printf("Could not save recording to %s\n", recordPath);
+	}
+
+	/* Time restoring the initial tower, as done for every new game */
+
+	const int resetNo = 100;
+	std::chrono::steady_clock::time_point resetStart = std::chrono::steady_clock::now();
+	for ( int i=0; i<resetNo; i++ )
+		physWorld.resetWorld();
+	double resetTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now()-resetStart).count();
+	printf("Reset latency: %.1f us\n", resetTime/resetNo);
+
+	physWorld.deleteWorld();
+
+	return 0;
+}
\ No newline at end of file
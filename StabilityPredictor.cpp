@@ -0,0 +1,220 @@
+#include "BlockTowerTools.h"
+
+StabilityPredictor::StabilityPredictor()
+{
+	blockNo = 0;
+	blockWeight = 0;
+	rowNo = 0;
+	columnNo = 0;
+	pivotNo = 0;
+}
+
+
+void StabilityPredictor::capture(PhysicsWorld& world)
+{
+	/* Take block poses and contact geometry from the world as it stands, for any number of predictions */
+
+	blockNo = world.getBlockNo();
+	blockWeight = world.getBlockWeight();
+	poses.resize(blockNo);
+	for ( int i=0; i<blockNo; i++ )
+		poses[i] = world.getBlockTransform(i);
+	world.getContactPoints(points);
+	role.resize(blockNo);
+}
+
+
+int StabilityPredictor::classify(const ContactPoint& contact)
+{
+	/* Find what a contact adds to the problem, once the blocks that must balance are known */
+
+	int role0 = contact.body0 >= 0 ? role[contact.body0] : -1;
+	int role1 = contact.body1 >= 0 ? role[contact.body1] : -1;
+	if ( role0 == -2 || role1 == -2 || ( role0 < 0 && role1 < 0 ) )
+		return PREDICT_IGNORED;
+
+	// Blocks held fixed above a balancing block press down on it as they do now
+	int fixedBlock = role0 < 0 ? contact.body0 : ( role1 < 0 ? contact.body1 : -1 );
+	int freeBlock = role0 < 0 ? contact.body1 : contact.body0;
+	if ( fixedBlock >= 0 &&
+		poses[fixedBlock].getOrigin().getY() > poses[freeBlock].getOrigin().getY()+PREDICT_SIDE_GAP
+	)
+		return PREDICT_LOAD;
+
+	return PREDICT_UNKNOWN;
+}
+
+
+void StabilityPredictor::addWrench(int column, int block, const btVector3& point, const btVector3& force)
+{
+	/* Add a force at a point to a block's equilibrium rows, in the given column, if the block must balance */
+
+	if ( block < 0 || role[block] < 0 )
+		return;
+
+	int width = columnNo+rowNo+1;
+	double* row = &tableau[6*role[block]*width+column];
+	btVector3 torque = (point-poses[block].getOrigin()).cross(force);	// About the block's centre of mass
+	for ( int k=0; k<3; k++ ) {
+		row[k*width] += force[k];
+		row[(k+3)*width] += torque[k];
+	}
+}
+
+
+bool StabilityPredictor::predict(const int* removed, int removedNo)
+{
+	/* Predict whether the captured tower stands with the given blocks taken out */
+
+	std::fill(role.begin(), role.end(), -1);
+	for ( int i=0; i<removedNo; i++ )
+		role[removed[i]] = -2;
+
+	// Blocks resting on a removed block have lost support, and must balance on what is left
+	freeBlocks.clear();
+	for ( size_t p=0; p<points.size(); p++ ) {
+		int body0 = points[p].body0;
+		int body1 = points[p].body1;
+		if ( body0 < 0 || body1 < 0 )
+			continue;
+		for ( int side=0; side<2; side++ ) {
+			int under = side ? body0 : body1;
+			int over = side ? body1 : body0;
+			if ( role[under] == -2 && role[over] == -1 &&
+				poses[over].getOrigin().getY() > poses[under].getOrigin().getY()+PREDICT_SIDE_GAP
+			) {
+				role[over] = int(freeBlocks.size());
+				freeBlocks.push_back(over);
+			}
+		}
+	}
+	pivotNo = 0;
+	if ( freeBlocks.empty() )
+		return true;	// Nothing rested on the removed blocks
+
+	int unknownNo = 0;
+	for ( size_t p=0; p<points.size(); p++ ) {
+		if ( classify(points[p]) == PREDICT_UNKNOWN )
+			unknownNo++;
+	}
+
+	rowNo = 6*int(freeBlocks.size());
+	columnNo = 4*unknownNo;
+	int width = columnNo+rowNo+1;
+	int rhs = width-1;
+	tableau.assign((rowNo+1)*width, 0);
+	basis.resize(rowNo);
+
+	// Forces and torques from the unknown contacts must cancel out each block's weight and fixed loads
+	for ( size_t b=0; b<freeBlocks.size(); b++ )
+		tableau[(6*b+1)*width+rhs] = blockWeight;
+
+	int column = 0;
+	for ( size_t p=0; p<points.size(); p++ ) {
+		const ContactPoint& contact = points[p];
+		int kind = classify(contact);
+		if ( kind == PREDICT_IGNORED )
+			continue;
+
+		if ( kind == PREDICT_LOAD ) {
+			// Moved to the right-hand side, as the force on the first body is known
+			btVector3 load = contact.normal*btMax(contact.force, btScalar(0));
+			addWrench(rhs, contact.body0, contact.position, -load);
+			addWrench(rhs, contact.body1, contact.position, load);
+			continue;
+		}
+
+		// Unknown force on the first body, within a pyramid about the friction cone
+		btVector3 normal = contact.normal;
+		btVector3 tangent1 = normal.cross(btFabs(normal.getY()) > 0.7 ? btVector3(1,0,0) : btVector3(0,1,0)).normalized();
+		btVector3 tangent2 = normal.cross(tangent1);
+		btScalar friction = contact.friction;
+		btVector3 edges[4] = {
+			normal+tangent1*friction, normal-tangent1*friction,
+			normal+tangent2*friction, normal-tangent2*friction
+		};
+		for ( int e=0; e<4; e++ ) {
+			addWrench(column+e, contact.body0, contact.position, edges[e]);
+			addWrench(column+e, contact.body1, contact.position, -edges[e]);
+		}
+		column += 4;
+	}
+
+	return isFeasible();
+}
+
+
+bool StabilityPredictor::isFeasible()
+{
+	/* Find whether the built constraints have a non-negative solution, by minimising
+	   the sum of an artificial variable per row until it reaches zero or can go no lower */
+
+	int width = columnNo+rowNo+1;
+	int rhs = width-1;
+	double* objective = &tableau[rowNo*width];
+
+	// Start from the artificial variables, with rows turned so every right-hand side is non-negative
+	double scale = 0;
+	for ( int i=0; i<rowNo; i++ ) {
+		double* row = &tableau[i*width];
+		if ( row[rhs] < 0 ) {
+			for ( int j=0; j<width; j++ )
+				row[j] = -row[j];
+		}
+		row[columnNo+i] = 1;
+		basis[i] = columnNo+i;
+		scale += row[rhs];
+
+		for ( int j=0; j<columnNo; j++ )
+			objective[j] -= row[j];
+		objective[rhs] -= row[rhs];
+	}
+
+	for ( pivotNo=0; pivotNo<PREDICT_PIVOT_LIMIT; pivotNo++ ) {
+		// Enter the column that lowers the sum fastest
+		int enter = -1;
+		double lowest = -1e-9;
+		for ( int j=0; j<rhs; j++ ) {
+			if ( objective[j] < lowest ) {
+				lowest = objective[j];
+				enter = j;
+			}
+		}
+		if ( enter < 0 )
+			break;		// Optimal
+
+		// Leave by the row that limits it first
+		int leave = -1;
+		double ratio = 0;
+		for ( int i=0; i<rowNo; i++ ) {
+			double a = tableau[i*width+enter];
+			if ( a > 1e-12 && ( leave < 0 || tableau[i*width+rhs]/a < ratio ) ) {
+				leave = i;
+				ratio = tableau[i*width+rhs]/a;
+			}
+		}
+		if ( leave < 0 )
+			break;		// Unbounded, which the sum of artificials cannot be
+
+		double* pivotRow = &tableau[leave*width];
+		double pivot = pivotRow[enter];
+		for ( int j=0; j<width; j++ )
+			pivotRow[j] /= pivot;
+		for ( int i=0; i<=rowNo; i++ ) {
+			double* row = &tableau[i*width];
+			double factor = row[enter];
+			if ( i == leave || factor == 0 )
+				continue;
+			for ( int j=0; j<width; j++ )
+				row[j] -= factor*pivotRow[j];
+		}
+		basis[leave] = enter;
+	}
+
+	return -objective[rhs] <= PREDICT_TOLERANCE*scale;
+}
+
+
+int StabilityPredictor::getRowNo() { return rowNo; }
+int StabilityPredictor::getColumnNo() { return columnNo; }
+int StabilityPredictor::getPivotNo() { return pivotNo; }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#define PREDICT_SIDE_GAP 0.75		// Height difference below which two touching blocks count as side by side
+#define PREDICT_TOLERANCE 1e-4		// Force left unbalanced, as a fraction of the load, still counted as balanced
+#define PREDICT_PIVOT_LIMIT 2000	// Simplex pivots before giving up and calling the tower unstable
+
+// What a contact point adds to the equilibrium problem
+#define PREDICT_IGNORED 0			// Nothing - it touches a removed block, or no block that must balance
+#define PREDICT_LOAD 1				// A known load, from a fixed block above
+#define PREDICT_UNKNOWN 2			// A force to be found
+
+// Predicts whether the tower stays up with some blocks taken out, without simulating it.
+// Blocks resting on the removed ones must each be held in static equilibrium by forces at
+// their remaining contacts, every force within a four-sided pyramid about its friction cone,
+// with the blocks above them pressing down as they do now. Whether such forces exist is a
+// linear feasibility problem, solved by the first phase of the simplex method.
+class StabilityPredictor
+{
+	int blockNo;
+	btScalar blockWeight;
+	std::vector<btTransform> poses;			// Block transformations when captured
+	std::vector<ContactPoint> points;		// Contacts when captured
+
+	// Working space, kept between predictions so predicting does not allocate once warm
+	std::vector<int> role;					// For each block, -2 if removed, -1 if held fixed, otherwise its row block
+	std::vector<int> freeBlocks;			// Blocks that must balance
+	std::vector<double> tableau;			// Equality constraints, then the objective, row by row
+	std::vector<int> basis;					// Column basic in each row
+	int rowNo;
+	int columnNo;
+	int pivotNo;							// Pivots taken by the last prediction
+
+	int classify(const ContactPoint& contact);
+	void addWrench(int column, int block, const btVector3& point, const btVector3& force);
+	bool isFeasible();
+
+public:
+	StabilityPredictor();
+	void capture(PhysicsWorld& world);
+	bool predict(const int* removed, int removedNo);
+	int getRowNo();
+	int getColumnNo();
+	int getPivotNo();
+};
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "BlockTowerTools.h"
+
+/* Headless tournament - plays many independent games across all cores, each from its own seed,
+   and reports how they went and how fast they were played */
+
+// Ways a game can end
+#define END_FALLEN 0		// A block came to rest away from the tower
+#define END_TOPPLED 1		// Nothing was left standing at the top of the tower
+#define END_TIMEOUT 2		// The game ran past its time limit without the tower coming down
+#define END_CAUSE_NO 3
+
+#define INSTANT_TICKS 3		// Median game length, in ticks, below which towers are taken to fall as games start
+
+// Run settings, adjustable from the command line
+int gameNo = 200;			// Number of games to play
+int stepRate = 120;			// Ticks per second of game time
+unsigned int seed = 1;		// Seed of the first game - each game after takes the next
+int blockNo = BLOCK_NO;		// Number of blocks in the tower
+int layerWidth = LAYER_WIDTH;	// Number of blocks in each layer
+int threadNo = 0;			// Threads to play games on (0 = all cores)
+int strategy = BOT_RANDOM;	// How the bot chooses blocks
+double timeLimit = 1800;	// Seconds of game time after which a game is abandoned
+const char* csvPath = 0;	// File to write a line per game to (0 for none)
+
+// How a single game went
+struct GameResult
+{
+	unsigned int seed;
+	int turnNo;
+	int score;
+	int cause;				// END_FALLEN, END_TOPPLED or END_TIMEOUT
+	int phase;				// Phase the game was in when the tower came down
+	double gameTime;		// Seconds of game time played
+	double wallTime;		// Seconds taken to play it
+	AllocationCount allocations;	// Bullet heap allocations made while playing it
+};
+
+// World and game session a worker plays its games on, built once and reset for every game
+struct TournamentTable
+{
+	PhysicsWorld world;
+	GameSession session;
+	GameInput input;
+	AllocationCount built;	// Bullet heap allocations made building the world
+};
+
+const char* causeNames[END_CAUSE_NO] = { "Block fell", "Top toppled", "Timed out" };
+const char* phaseNames[PHASE_COLLAPSE+1] = { "choose", "select", "remove", "raise", "place", "check", "collapse" };
+
+
+double percentile(std::vector<double>& samples, double fraction)
+{
+	/* Get value below which the given fraction of sorted samples lie */
+
+	if ( samples.empty() )
+		return 0;
+
+	size_t index = size_t(fraction*(samples.size()-1)+0.5);
+	return samples[std::min(index, samples.size()-1)];
+}
+
+
+void playGame(TournamentTable& table, unsigned int gameSeed, GameResult& result)
+{
+	/* Play one game on the seed's tower, restored by newGame, until it comes down or runs out of time */
+
+	std::chrono::steady_clock::time_point gameStart = std::chrono::steady_clock::now();
+	AllocationCount before = getThreadAllocations();
+
+	table.world.setSeed(gameSeed);
+	table.session.newGame();
+	GameBot bot(&table.world, strategy, gameSeed);
+
+	double dt = 1.0/stepRate;
+	int tickNo = 0;
+	int lastPhase = PHASE_CHOOSE;
+	while ( table.session.getState().phase != PHASE_COLLAPSE && tickNo < timeLimit*stepRate ) {
+		const GameState& state = table.session.getState();
+		lastPhase = state.phase;
+		bot.play(state, table.session.getTransforms(), table.input);
+		table.session.tick(dt, table.input);
+		tickNo++;
+	}
+
+	const GameState& state = table.session.getState();
+	const TowerCheck& check = table.session.getCheck();
+	AllocationCount after = getThreadAllocations();
+
+	result.seed = gameSeed;
+	result.turnNo = state.turnNo;
+	result.score = state.score;
+	if ( state.phase != PHASE_COLLAPSE )
+		result.cause = END_TIMEOUT;
+	else
+		result.cause = check.fallen ? END_FALLEN : END_TOPPLED;
+	result.phase = lastPhase;
+	result.gameTime = tickNo*dt;
+	result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-gameStart).count();
+	result.allocations.allocations = after.allocations-before.allocations;
+	result.allocations.bytes = after.bytes-before.bytes;
+}
+
+
+void writeCsv(const std::vector<GameResult>& results)
+{
+	/* Write a line per game, for comparing runs outside the tournament */
+
+	FILE* csv = fopen(csvPath, "w");
+	if ( !csv ) {
+		printf("Could not open %s for writing\n", csvPath);
+		return;
+	}
+
+	fprintf(csv, "seed,turns,score,cause,phase,game_s,wall_ms,allocations,bytes\n");
+	for ( size_t g=0; g<results.size(); g++ ) {
+		const GameResult& result = results[g];
+		fprintf(csv, "%u,%d,%d,%s,%s,%.3f,%.3f,%lu,%lu\n",
+			result.seed, result.turnNo, result.score, causeNames[result.cause], phaseNames[result.phase],
+			result.gameTime, result.wallTime*1000, result.allocations.allocations, result.allocations.bytes);
+	}
+	fclose(csv);
+}
+
+
+int main(int argc, char **argv)
+{
+	/* Read settings from command line */
+
+	for ( int i=1; i<argc; i++ ) {
+		if ( !strcmp(argv[i], "--games") && i+1 < argc )
+			gameNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--rate") && i+1 < argc )
+			stepRate = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--seed") && i+1 < argc )
+			seed = (unsigned int)atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--blocks") && i+1 < argc )
+			blockNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--width") && i+1 < argc )
+			layerWidth = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--threads") && i+1 < argc )
+			threadNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--safest") )
+			strategy = BOT_SAFEST;
+		else if ( !strcmp(argv[i], "--limit") && i+1 < argc )
+			timeLimit = atof(argv[++i]);
+		else if ( !strcmp(argv[i], "--csv") && i+1 < argc )
+			csvPath = argv[++i];
+		else {
+			printf("Usage: %s [--games N] [--rate HZ] [--seed S] [--blocks N] [--width W] [--threads T] [--safest] [--limit SECONDS] [--csv FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+	if ( gameNo <= 0 || stepRate <= 0 || blockNo <= 0 || layerWidth <= 0 || timeLimit <= 0 ) {
+		printf("Game count, step rate, block count, layer width and time limit must be positive\n");
+		return 1;
+	}
+
+	/* Build a table for each worker, in parallel */
+
+	WorkerPool pool(threadNo);
+	int tableNo = pool.getThreadNo();
+	TournamentTable* tables = new TournamentTable[tableNo];
+	pool.run(tableNo, [&](int t) {
+		AllocationCount before = getThreadAllocations();
+		tables[t].world.setSeed(seed);
+		tables[t].world.setStepRate(stepRate);
+		tables[t].world.setTowerSize(blockNo, layerWidth);
+		tables[t].world.createWorld();
+		tables[t].session.start(&tables[t].world);
+		AllocationCount after = getThreadAllocations();
+		tables[t].built.allocations = after.allocations-before.allocations;
+		tables[t].built.bytes = after.bytes-before.bytes;
+	});
+
+	/* Play the games, each worker claiming the next until none are left */
+
+	std::vector<GameResult> results(gameNo);
+	std::atomic<int> nextGame(0);
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	pool.run(tableNo, [&](int t) {
+		for ( int g = nextGame++; g < gameNo; g = nextGame++ )
+			playGame(tables[t], seed+g, results[g]);
+	});
+	double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-runStart).count();
+
+	/* Gather results */
+
+	std::vector<double> scores, turns, wallTimes, gameTimes;
+	int causes[END_CAUSE_NO][PHASE_COLLAPSE+1] = {};
+	double gameTime = 0;
+	double allocationNo = 0, allocationBytes = 0;
+	for ( int g=0; g<gameNo; g++ ) {
+		const GameResult& result = results[g];
+		scores.push_back(result.score);
+		turns.push_back(result.turnNo);
+		wallTimes.push_back(result.wallTime*1000);
+		gameTimes.push_back(result.gameTime);
+		causes[result.cause][result.phase]++;
+		gameTime += result.gameTime;
+		allocationNo += result.allocations.allocations;
+		allocationBytes += result.allocations.bytes;
+	}
+	std::sort(scores.begin(), scores.end());
+	std::sort(turns.begin(), turns.end());
+	std::sort(wallTimes.begin(), wallTimes.end());
+	std::sort(gameTimes.begin(), gameTimes.end());
+
+	double builtBytes = 0;
+	for ( int t=0; t<tableNo; t++ )
+		builtBytes += tables[t].built.bytes;
+
+	/* Report results */
+
+	printf("Blocks:        %d (%d per layer)\n", blockNo, layerWidth);
+	printf("Bot:           %s, seeds %u to %u\n", strategy == BOT_SAFEST ? "safest block" : "random block", seed, seed+gameNo-1);
+	printf("Games:         %d on %d threads in %.3f s\n", gameNo, tableNo, runTime);
+	printf("Games/sec:     %.2f (%.0fx real time)\n", gameNo/runTime, gameTime/runTime);
+	printf("Game length:   %.1f s of game time on average, wall time p50 %.1f ms, p90 %.1f ms, max %.1f ms\n",
+		gameTime/gameNo, percentile(wallTimes, 0.50), percentile(wallTimes, 0.90), percentile(wallTimes, 1.00));
+	printf("Turns:         p10 %.0f, p50 %.0f, p90 %.0f, max %.0f\n",
+		percentile(turns, 0.10), percentile(turns, 0.50), percentile(turns, 0.90), percentile(turns, 1.00));
+	printf("Scores:        p10 %.0f, p50 %.0f, p90 %.0f, max %.0f\n",
+		percentile(scores, 0.10), percentile(scores, 0.50), percentile(scores, 0.90), percentile(scores, 1.00));
+
+	// Score histogram, in at most ten buckets
+	int lowest = int(scores.front());
+	int highest = int(scores.back());
+	int bucketWidth = std::max(1, (highest-lowest)/10+1);
+	for ( int low=lowest; low<=highest; low+=bucketWidth ) {
+		int count = 0;
+		for ( int g=0; g<gameNo; g++ )
+			count += scores[g] >= low && scores[g] < low+bucketWidth ? 1 : 0;
+		printf("  %4d to %4d  %6d  %5.1f%%\n", low, low+bucketWidth-1, count, 100.0*count/gameNo);
+	}
+
+	printf("Ended by:\n");
+	for ( int c=0; c<END_CAUSE_NO; c++ ) {
+		for ( int p=0; p<=PHASE_COLLAPSE; p++ ) {
+			if ( causes[c][p] > 0 )
+				printf("  %-12s in %-8s  %6d  %5.1f%%\n", causeNames[c], phaseNames[p], causes[c][p], 100.0*causes[c][p]/gameNo);
+		}
+	}
+
+	printf("Memory:        %.1f KB per world, built once per thread\n", builtBytes/tableNo/1024);
+	printf("Per game:      %.0f allocations, %.1f KB allocated\n", allocationNo/gameNo, allocationBytes/gameNo/1024);
+
+	if ( csvPath )
+		writeCsv(results);
+
+	// Games over within a few ticks mean towers falling as they start, not anything the bot did
+	bool instant = percentile(gameTimes, 0.50) < double(INSTANT_TICKS)/stepRate;
+	if ( instant )
+		printf("Half the games ended within %d ticks - the towers are not standing when games start\n", INSTANT_TICKS);
+
+	/* Tear down the tables */
+
+	pool.run(tableNo, [&](int t) { tables[t].world.deleteWorld(); });
+	delete[] tables;
+
+	return instant ? 1 : 0;
+}
\ No newline at end of file
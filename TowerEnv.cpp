@@ -0,0 +1,138 @@
+#include "BlockTowerTools.h"
+
+TowerEnv::TowerEnv(int newWorldNo, int threadNo, unsigned int seed, int newStepRate, int newBlockNo, int layerWidth) :
+	pool(threadNo)
+{
+	worldNo = std::max(1, newWorldNo);
+	stepRate = newStepRate;
+	blockNo = newBlockNo > 0 ? newBlockNo : BLOCK_NO;
+
+	// Allocate all buffers up front, so stepping never allocates
+	worlds = new PhysicsWorld[worldNo];
+	boxTrans = new btTransform[worldNo*blockNo];
+	actions = new float[worldNo*TOWER_ACTION_SIZE]();
+	observations = new float[worldNo*blockNo*TOWER_OBSERVATION_SIZE]();
+
+	// Build towers in parallel, each with its own seed
+	pool.run(worldNo, [this, seed, layerWidth](int i) {
+		worlds[i].setSeed(seed+i);
+		worlds[i].setTowerSize(blockNo, layerWidth);
+		worlds[i].setStepRate(stepRate);
+		worlds[i].createWorld();
+		worlds[i].advanceWorld(0, &boxTrans[i*blockNo]);
+		observe(i);
+	});
+}
+
+
+TowerEnv::~TowerEnv()
+{
+	pool.run(worldNo, [this](int i) { worlds[i].deleteWorld(); });
+
+	delete[] observations;
+	delete[] actions;
+	delete[] boxTrans;
+	delete[] worlds;
+}
+
+
+void TowerEnv::reset(int worldIndex, unsigned int seed)
+{
+	/* Rebuild tower of one world, or of all worlds if index is negative */
+
+	if ( worldIndex >= worldNo )
+		return;
+
+	int first = std::max(0, worldIndex);
+	int count = worldIndex < 0 ? worldNo : 1;
+
+	pool.run(count, [this, first, seed](int i) {
+		int w = first+i;
+		worlds[w].setSeed(seed+i);
+		worlds[w].resetWorld();
+		worlds[w].advanceWorld(0, &boxTrans[w*blockNo]);
+		for (int j=0; j<TOWER_ACTION_SIZE; j++)
+			actions[w*TOWER_ACTION_SIZE+j] = 0;
+		observe(w);
+	});
+}
+
+
+void TowerEnv::step(int frameNo)
+{
+	/* Apply pending actions, then advance all worlds in parallel */
+
+	btScalar timeStep = btScalar(1.0/stepRate);
+
+	pool.run(worldNo, [this, frameNo, timeStep](int i) {
+		applyAction(i);
+		for (int frame=0; frame<frameNo; frame++)
+			worlds[i].advanceWorld(timeStep, &boxTrans[i*blockNo]);
+		observe(i);
+	});
+}
+
+
+void TowerEnv::applyAction(int worldIndex)
+{
+	/* Pass a world's pending action to its physics world, then clear it */
+
+	float* action = &actions[worldIndex*TOWER_ACTION_SIZE];
+	int objectIndex = int(action[1]);
+	double target[3] = { action[3], action[4], action[5] };
+	double objectSelect[3] = { 0, 0, 0 };
+
+	if ( objectIndex < 0 || objectIndex >= blockNo )
+		objectIndex = -1;	// Ignored by all physics world actions
+
+	switch ( int(action[0]) ) {
+	case TOWER_ACTION_PUSH:
+		worlds[worldIndex].pushObject(objectIndex, action[2], target);
+		break;
+	case TOWER_ACTION_TURN:
+		worlds[worldIndex].turnObject(objectIndex, action[2]);
+		break;
+	case TOWER_ACTION_DRAG:
+		worlds[worldIndex].dragObject(objectIndex, target, objectSelect);
+		break;
+	case TOWER_ACTION_RAISE:
+		worlds[worldIndex].raiseObjectTo(objectIndex, action[2]);
+		break;
+	case TOWER_ACTION_STOP:
+		worlds[worldIndex].stopObject(objectIndex);
+		break;
+	default:
+		break;
+	}
+
+	action[0] = TOWER_ACTION_NONE;
+}
+
+
+void TowerEnv::observe(int worldIndex)
+{
+	/* Write current state of a world's blocks to the observation buffer */
+
+	for (int i=0; i<blockNo; i++) {
+		const btTransform& trans = boxTrans[worldIndex*blockNo+i];
+		btQuaternion rotation = trans.getRotation();
+		float* observation = &observations[(worldIndex*blockNo+i)*TOWER_OBSERVATION_SIZE];
+
+		observation[0] = trans.getOrigin().getX();
+		observation[1] = trans.getOrigin().getY();
+		observation[2] = trans.getOrigin().getZ();
+		observation[3] = rotation.getX();
+		observation[4] = rotation.getY();
+		observation[5] = rotation.getZ();
+		observation[6] = rotation.getW();
+		observation[7] = worlds[worldIndex].isActive(i) ? 1.0f : 0.0f;
+		observation[8] = worlds[worldIndex].checkContact(i) ? 1.0f : 0.0f;
+		observation[9] = worlds[worldIndex].getLoad(i);
+	}
+}
+
+
+float* TowerEnv::getActions() { return actions; }
+const float* TowerEnv::getObservations() { return observations; }
+int TowerEnv::getWorldNo() { return worldNo; }
+int TowerEnv::getBlockNo() { return blockNo; }
\ No newline at end of file
@@ -0,0 +1,28 @@
+class TowerEnv
+{
+	int worldNo;				// Number of independent worlds
+	int stepRate;				// Internal physics steps per second, shared by all worlds
+	int blockNo;				// Number of blocks in each world's tower
+
+	PhysicsWorld* worlds;		// Array of worlds
+	btTransform* boxTrans;		// Transformations of blocks, for all worlds in turn
+	float* actions;				// Pending action for each world
+	float* observations;		// Latest observation of each block in each world
+
+	WorkerPool pool;			// Threads for stepping worlds in parallel
+
+	void applyAction(int worldIndex);
+	void observe(int worldIndex);
+
+public:
+	TowerEnv(int newWorldNo, int threadNo, unsigned int seed, int newStepRate, int newBlockNo, int layerWidth);
+	~TowerEnv();
+
+	void reset(int worldIndex, unsigned int seed);
+	void step(int frameNo);
+
+	float* getActions();
+	const float* getObservations();
+	int getWorldNo();
+	int getBlockNo();
+};
\ No newline at end of file
@@ -0,0 +1,21 @@
+#include "BlockTowerTools.h"
+
+/* C interface to TowerEnv - the handle is the environment itself */
+
+#define ENV(handle) reinterpret_cast<TowerEnv*>(handle)
+
+TowerEnvHandle* towerEnvCreate(int worldNo, int threadNo, unsigned int seed, int blockNo, int layerWidth)
+{
+	return reinterpret_cast<TowerEnvHandle*>(new TowerEnv(worldNo, threadNo, seed, 120, blockNo, layerWidth));
+}
+
+
+void towerEnvDestroy(TowerEnvHandle* env) { delete ENV(env); }
+void towerEnvReset(TowerEnvHandle* env, int worldIndex, unsigned int seed) { ENV(env)->reset(worldIndex, seed); }
+void towerEnvStep(TowerEnvHandle* env, int frameNo) { ENV(env)->step(frameNo); }
+
+float* towerEnvActions(TowerEnvHandle* env) { return ENV(env)->getActions(); }
+const float* towerEnvObservations(TowerEnvHandle* env) { return ENV(env)->getObservations(); }
+
+int towerEnvWorldNo(TowerEnvHandle* env) { return ENV(env)->getWorldNo(); }
+int towerEnvBlockNo(TowerEnvHandle* env) { return ENV(env)->getBlockNo(); }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef TOWER_ENV_API_H
+#define TOWER_ENV_API_H
+
+/* Plain C interface to a batch of independent tower worlds */
+
+#if defined(_WIN32)
+#define TOWER_ENV_EXPORT __declspec(dllexport)
+#else
+#define TOWER_ENV_EXPORT __attribute__((visibility("default")))
+#endif
+
+// Action types, written to the first value of a world's action
+#define TOWER_ACTION_NONE 0		// Do nothing
+#define TOWER_ACTION_PUSH 1		// Push block horizontally:	impulse, target x, target y, target z
+#define TOWER_ACTION_TURN 2		// Turn block about vertical:	impulse
+#define TOWER_ACTION_DRAG 3		// Drag block towards point:	-, target x, target y, target z
+#define TOWER_ACTION_RAISE 4	// Raise block to height:		height
+#define TOWER_ACTION_STOP 5		// Cancel all block velocity
+
+// Action layout per world: type, block index, then four parameters
+#define TOWER_ACTION_SIZE 6
+
+// Observation layout per block: position (3), rotation quaternion x,y,z,w (4), active flag, contact flag,
+// weight carried from blocks above (in block weights)
+#define TOWER_OBSERVATION_SIZE 10
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TowerEnvHandle TowerEnvHandle;
+
+// Create worldNo towers, stepped by threadNo threads (0 = all cores); world k is built with seed+k.
+// Each tower has blockNo blocks in layers of layerWidth (0 for the standard tower)
+TOWER_ENV_EXPORT TowerEnvHandle* towerEnvCreate(int worldNo, int threadNo, unsigned int seed, int blockNo, int layerWidth);
+TOWER_ENV_EXPORT void towerEnvDestroy(TowerEnvHandle* env);
+
+// Rebuild one world's tower with a new seed, or every world (worldIndex -1, world k gets seed+k)
+TOWER_ENV_EXPORT void towerEnvReset(TowerEnvHandle* env, int worldIndex, unsigned int seed);
+
+// Apply pending actions once, then advance every world by frameNo physics steps
+TOWER_ENV_EXPORT void towerEnvStep(TowerEnvHandle* env, int frameNo);
+
+// Buffers stay at the same address for the lifetime of the environment
+TOWER_ENV_EXPORT float* towerEnvActions(TowerEnvHandle* env);				// worldNo * TOWER_ACTION_SIZE
+TOWER_ENV_EXPORT const float* towerEnvObservations(TowerEnvHandle* env);	// worldNo * blockNo * TOWER_OBSERVATION_SIZE
+
+TOWER_ENV_EXPORT int towerEnvWorldNo(TowerEnvHandle* env);
+TOWER_ENV_EXPORT int towerEnvBlockNo(TowerEnvHandle* env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
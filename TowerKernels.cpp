@@ -0,0 +1,141 @@
+#include "BlockTowerPhysics.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define KERNEL_FLOATS 8		// Floats compared per instruction
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KERNEL_FLOATS 4
+#else
+#define KERNEL_FLOATS 1		// Scalar fallback
+#endif
+
+
+void TowerState::resize(int blockNo)
+{
+	x.assign(blockNo, 0);
+	y.assign(blockNo, 0);
+	z.assign(blockNo, 0);
+	vx.assign(blockNo, 0);
+	vy.assign(blockNo, 0);
+	vz.assign(blockNo, 0);
+	active.assign(blockNo, 0);
+}
+
+
+void maskGreater(const float* values, int count, float threshold, uint64_t* mask)
+{
+	/* Set bits for values above threshold */
+
+	std::fill(mask, mask+maskWords(count), uint64_t(0));
+	int i = 0;
+
+#if KERNEL_FLOATS == 8
+	__m256 limit = _mm256_set1_ps(threshold);
+	for ( ; i+8<=count; i+=8 ) {
+		int bits = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values+i), limit, _CMP_GT_OQ));
+		mask[i>>6] |= uint64_t(bits) << (i&63);
+	}
+#elif KERNEL_FLOATS == 4
+	__m128 limit = _mm_set1_ps(threshold);
+	for ( ; i+4<=count; i+=4 ) {
+		int bits = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(values+i), limit));
+		mask[i>>6] |= uint64_t(bits) << (i&63);
+	}
+#endif
+
+	// Remaining values, or all of them without SIMD
+	for ( ; i<count; i++ )
+		if ( values[i] > threshold )
+			mask[i>>6] |= uint64_t(1) << (i&63);
+}
+
+
+void maskEitherGreater(const float* a, const float* b, int count, float threshold, uint64_t* mask)
+{
+	/* Set bits where either of two values is above threshold */
+
+	std::fill(mask, mask+maskWords(count), uint64_t(0));
+	int i = 0;
+
+#if KERNEL_FLOATS == 8
+	__m256 limit = _mm256_set1_ps(threshold);
+	for ( ; i+8<=count; i+=8 ) {
+		__m256 compare = _mm256_or_ps(
+			_mm256_cmp_ps(_mm256_loadu_ps(a+i), limit, _CMP_GT_OQ),
+			_mm256_cmp_ps(_mm256_loadu_ps(b+i), limit, _CMP_GT_OQ));
+		mask[i>>6] |= uint64_t(_mm256_movemask_ps(compare)) << (i&63);
+	}
+#elif KERNEL_FLOATS == 4
+	__m128 limit = _mm_set1_ps(threshold);
+	for ( ; i+4<=count; i+=4 ) {
+		__m128 compare = _mm_or_ps(
+			_mm_cmpgt_ps(_mm_loadu_ps(a+i), limit),
+			_mm_cmpgt_ps(_mm_loadu_ps(b+i), limit));
+		mask[i>>6] |= uint64_t(_mm_movemask_ps(compare)) << (i&63);
+	}
+#endif
+
+	for ( ; i<count; i++ )
+		if ( a[i] > threshold || b[i] > threshold )
+			mask[i>>6] |= uint64_t(1) << (i&63);
+}
+
+
+void maskNonZero(const unsigned char* flags, int count, uint64_t* mask)
+{
+	/* Set bits for flags that are set */
+
+	std::fill(mask, mask+maskWords(count), uint64_t(0));
+	int i = 0;
+
+#if KERNEL_FLOATS > 1
+	// Sixteen flags per comparison - blocks of 16 never straddle a mask word
+	__m128i zero = _mm_setzero_si128();
+	for ( ; i+16<=count; i+=16 ) {
+		__m128i isZero = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(flags+i)), zero);
+		int bits = ~_mm_movemask_epi8(isZero) & 0xFFFF;
+		mask[i>>6] |= uint64_t(bits) << (i&63);
+	}
+#endif
+
+	for ( ; i<count; i++ )
+		if ( flags[i] )
+			mask[i>>6] |= uint64_t(1) << (i&63);
+}
+
+
+void maskPositive(const int* values, int count, uint64_t* mask)
+{
+	/* Set bits for values above zero */
+
+	std::fill(mask, mask+maskWords(count), uint64_t(0));
+	int i = 0;
+
+#if KERNEL_FLOATS > 1
+	__m128i zero = _mm_setzero_si128();
+	for ( ; i+4<=count; i+=4 ) {
+		__m128i compare = _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values+i)), zero);
+		mask[i>>6] |= uint64_t(_mm_movemask_ps(_mm_castsi128_ps(compare))) << (i&63);
+	}
+#endif
+
+	for ( ; i<count; i++ )
+		if ( values[i] > 0 )
+			mask[i>>6] |= uint64_t(1) << (i&63);
+}
+
+
+bool maskAny(const uint64_t* mask, int count)
+{
+	for ( int w=0; w<maskWords(count); w++ )
+		if ( mask[w] )
+			return true;
+	return false;
+}
+
+
+bool maskTest(const uint64_t* mask, int index)
+{
+	return ( mask[index>>6] >> (index&63) ) & 1;
+}
\ No newline at end of file
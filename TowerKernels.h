@@ -0,0 +1,21 @@
+// Structure-of-arrays copy of block state, laid out for batch checks
+struct TowerState
+{
+	std::vector<float> x, y, z;			// Positions
+	std::vector<float> vx, vy, vz;		// Linear velocities
+	std::vector<unsigned char> active;	// 1 if block is active, 0 if asleep
+
+	void resize(int blockNo);
+};
+
+// Number of 64-bit words in a mask with one bit per block
+inline int maskWords(int count) { return (count+63)/64; }
+
+// Batch kernels - each writes bit i of mask for element i, leaving bits past count clear
+void maskGreater(const float* values, int count, float threshold, uint64_t* mask);
+void maskEitherGreater(const float* a, const float* b, int count, float threshold, uint64_t* mask);
+void maskNonZero(const unsigned char* flags, int count, uint64_t* mask);
+void maskPositive(const int* values, int count, uint64_t* mask);
+
+bool maskAny(const uint64_t* mask, int count);
+bool maskTest(const uint64_t* mask, int index);
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "BlockTowerTools.h"
+
+TowerSolver::TowerSolver(int threadNo, int newStepRate, int newBlockNo, int newLayerWidth) :
+	pool(threadNo)
+{
+	stepRate = newStepRate;
+	blockNo = newBlockNo > 0 ? newBlockNo : BLOCK_NO;
+	layerWidth = newLayerWidth > 0 ? newLayerWidth : LAYER_WIDTH;
+	lastRate = 0;
+
+	// Build a world for each worker in parallel - block shapes come with each snapshot restored
+	forkNo = pool.getThreadNo();
+	forks = new SolverFork[forkNo];
+	pool.run(forkNo, [this](int f) {
+		forks[f].world.setTowerSize(blockNo, layerWidth);
+		forks[f].world.setStepRate(stepRate);
+		forks[f].world.createWorld();
+		forks[f].trans.resize(blockNo);
+		forks[f].start.resize(blockNo);
+	});
+}
+
+
+TowerSolver::~TowerSolver()
+{
+	pool.run(forkNo, [this](int f) { forks[f].world.deleteWorld(); });
+
+	delete[] forks;
+}
+
+
+void TowerSolver::findMoves(const WorldSnapshot& snapshot, double towerHeight, std::vector<SolverMove>& moves)
+{
+	/* List every block the game would let be taken, against every free spot in the layer being built on top */
+
+	moves.clear();
+
+	// Fill the top layer if it has room, otherwise start the one above
+	btScalar topY = 0;
+	for ( int i=0; i<blockNo; i++ )
+		topY = std::max(topY, snapshot.bodies[i].worldTrans.getOrigin().getY());
+	int topLayer = std::max(0, int(floor((topY-0.75)/1.5+0.5)));
+	int topCount = 0;
+	for ( int i=0; i<blockNo; i++ ) {
+		if ( btFabs(snapshot.bodies[i].worldTrans.getOrigin().getY()-(0.75+topLayer*1.5)) < 0.5 )
+			topCount++;
+	}
+	int placeLayer = topCount >= layerWidth ? topLayer+1 : topLayer;
+	btScalar layerY = btScalar(0.75+placeLayer*1.5);
+	bool across = placeLayer%2 == 1;	// Odd layers are turned a right angle and spread along X, as built
+
+	// Spots in the layer with no block over them
+	std::vector<btVector3> spots;
+	for ( int j=0; j<layerWidth; j++ ) {
+		btScalar offset = btScalar(2.5*(j-(layerWidth-1)/2.0));
+		btVector3 spot = across ? btVector3(offset, layerY, 0) : btVector3(0, layerY, offset);
+
+		bool taken = false;
+		for ( int i=0; i<blockNo && !taken; i++ ) {
+			btVector3 origin = snapshot.bodies[i].worldTrans.getOrigin();
+			taken = btFabs(origin.getY()-layerY) < 0.5 &&
+				btVector3(origin.getX()-spot.getX(), 0, origin.getZ()-spot.getZ()).length() < 1.25;
+		}
+		if ( !taken )
+			spots.push_back(spot+btVector3(0, btScalar(SOLVER_DROP_HEIGHT), 0));
+	}
+
+	for ( int i=0; i<blockNo; i++ ) {
+		if ( snapshot.bodies[i].worldTrans.getOrigin().getY() >= towerHeight-LAYER_HEIGHT )
+			continue;	// Only blocks below the top complete layer may be taken
+		for ( size_t s=0; s<spots.size(); s++ ) {
+			SolverMove move = { i, spots[s], across ? 90.0 : 0.0, false, false, false, 0, 0, SOLVER_FAILED };
+			moves.push_back(move);
+		}
+	}
+}
+
+
+void TowerSolver::simulate(PhysicsWorld& world, btTransform* trans, btTransform* start, SolverMove& move, double towerHeight)
+{
+	/* Drag a block out along its length until it is clear of the tower, put it down in
+	   its new spot, then step until the tower is at rest and see how it has fared */
+
+	btScalar timeStep = btScalar(1.0/stepRate);
+	int index = move.objectIndex;
+	for ( int i=0; i<blockNo; i++ )
+		start[i] = world.getBlockTransform(i);
+
+	// Pull out of the nearer end, level with where the block started
+	btVector3 origin = start[index].getOrigin();
+	btVector3 axis = start[index].getBasis().getColumn(0);	// Blocks are longest along their own X
+	axis.setY(0);
+	if ( axis.length2() < 0.01 )
+		axis.setValue(1,0,0);		// Block on its end - any way out will do
+	axis.normalize();
+	if ( axis.dot(origin) < 0 )
+		axis = -axis;
+
+	double select[3] = { 0, 0, 0 };
+	int pullSteps = 0;
+	for ( ; pullSteps < SOLVER_PULL_TIME*stepRate; pullSteps++ ) {
+		btVector3 boxOrigin = world.getBlockTransform(index).getOrigin();
+		double target[3] = {
+			boxOrigin.getX()+axis.getX()*SOLVER_PULL_DISTANCE,
+			origin.getY(),
+			boxOrigin.getZ()+axis.getZ()*SOLVER_PULL_DISTANCE
+		};
+		world.dragObject(index, target, select);
+		world.advanceWorld(timeStep, trans);
+		if ( !world.checkContact(index) )
+			break;		// Clear of the tower
+	}
+
+	// Lifting it over the top does not disturb the tower, so put it straight down
+	world.placeObject(index, move.placeOrigin, move.placeYaw);
+
+	bool settled = false;
+	world.watchSettle([&settled]() { settled = true; });
+	int settleSteps = 0;
+	for ( ; !settled && settleSteps < SOLVER_SETTLE_TIME*stepRate; settleSteps++ )
+		world.advanceWorld(timeStep, trans);
+	world.cancelSettle();
+
+	// Judge the tower as the game would, once the placement has been checked
+	TowerCheck check = world.checkTower(towerHeight-LAYER_HEIGHT, -1);
+	btScalar placedY = world.getBlockTransform(index).getOrigin().getY();
+	move.collapsed = !check.standing || check.fallen;
+	move.valid = placedY >= towerHeight-2*LAYER_HEIGHT && placedY <= towerHeight+LAYER_HEIGHT;
+
+	move.displacement = 0;
+	for ( int i=0; i<blockNo; i++ ) {
+		if ( i != index )
+			move.displacement += world.getBlockTransform(i).getOrigin().distance(start[i].getOrigin());
+	}
+	move.settleTime = double(pullSteps+settleSteps)/stepRate;
+
+	if ( move.collapsed || !move.valid )
+		move.score = SOLVER_FAILED-move.displacement;
+	else
+		move.score = -move.displacement-SOLVER_SETTLE_WEIGHT*move.settleTime;
+	move.evaluated = true;
+}
+
+
+int TowerSolver::solve(const WorldSnapshot& snapshot, double towerHeight, double budget, std::vector<SolverMove>& moves)
+{
+	/* Simulate as many candidate moves as fit in budget seconds (no limit if not positive),
+	   and sort them best first, with any not reached in time last. Returns the number simulated. */
+
+	findMoves(snapshot, towerHeight, moves);
+
+	std::chrono::steady_clock::time_point solveStart = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point deadline = solveStart +
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget > 0 ? budget : 1e6));
+
+	// Each worker keeps to its own world, claiming moves until none are left or time is up
+	int moveNo = int(moves.size());
+	std::atomic<int> nextMove(0);
+	pool.run(forkNo, [&](int f) {
+		SolverFork& fork = forks[f];
+		while ( std::chrono::steady_clock::now() < deadline ) {
+			int m = nextMove++;
+			if ( m >= moveNo )
+				break;
+			fork.world.restoreSnapshot(snapshot);
+			simulate(fork.world, fork.trans.data(), fork.start.data(), moves[m], towerHeight);
+		}
+	});
+
+	int evaluatedNo = 0;
+	for ( int m=0; m<moveNo; m++ )
+		evaluatedNo += moves[m].evaluated ? 1 : 0;
+	double solveTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-solveStart).count();
+	lastRate = solveTime > 0 ? evaluatedNo/solveTime : 0;
+
+	std::stable_sort(moves.begin(), moves.end(), [](const SolverMove& a, const SolverMove& b) {
+		if ( a.evaluated != b.evaluated )
+			return a.evaluated;
+		return a.score > b.score;
+	});
+
+	return evaluatedNo;
+}
+
+
+void TowerSolver::playMove(PhysicsWorld& world, SolverMove& move, double towerHeight)
+{
+	/* Play a move on a world of the same size directly, filling in how it went */
+
+	std::vector<btTransform> trans(blockNo), start(blockNo);
+	simulate(world, trans.data(), start.data(), move, towerHeight);
+}
+
+
+double TowerSolver::measureDrift(const WorldSnapshot& snapshot)
+{
+	/* Restore a snapshot into a fork and step it for a second with no move, returning how far the blocks
+	   moved in total - a standing tower should hardly move, or every candidate starts from a disturbed one */
+
+	SolverFork& fork = forks[0];
+	fork.world.restoreSnapshot(snapshot);
+	for ( int i=0; i<blockNo; i++ )
+		fork.start[i] = fork.world.getBlockTransform(i);
+
+	for ( int step=0; step<stepRate; step++ )
+		fork.world.advanceWorld(btScalar(1.0/stepRate), fork.trans.data());
+
+	double drift = 0;
+	for ( int i=0; i<blockNo; i++ )
+		drift += fork.world.getBlockTransform(i).getOrigin().distance(fork.start[i].getOrigin());
+	return drift;
+}
+
+
+int TowerSolver::getThreadNo() { return forkNo; }
+double TowerSolver::getRate() { return lastRate; }
\ No newline at end of file
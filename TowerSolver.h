@@ -0,0 +1,56 @@
+#define SOLVER_PULL_TIME 1.0		// Longest time, in seconds, a block is dragged for to get it clear of the tower
+#define SOLVER_PULL_DISTANCE 4		// How far ahead of the block it is dragged towards
+#define SOLVER_SETTLE_TIME 4.0		// Longest time, in seconds, the tower is given to come to rest after a placement
+#define SOLVER_DROP_HEIGHT 0.05		// Gap left under a placed block
+#define SOLVER_SETTLE_WEIGHT 0.5	// Score lost per second of settling, against a block's length of displacement
+#define SOLVER_FAILED -1000			// Score for a move that brings the tower down or would not count
+#define SOLVER_DRIFT_LIMIT 0.01		// Most the blocks of a restored fork may move in total when nothing is done to them
+
+// A block to take out, where to put it, and how that went when simulated
+struct SolverMove
+{
+	int objectIndex;		// Block removed
+	btVector3 placeOrigin;	// Where the block is put down
+	double placeYaw;		// Turn of the placed block about the vertical, in degrees
+
+	bool evaluated;			// Whether the move was simulated within the time budget
+	bool collapsed;			// Whether the tower fell
+	bool valid;				// Whether the placement would pass the game's check
+	double displacement;	// Total distance moved by the other blocks
+	double settleTime;		// Seconds from starting the pull until the tower was at rest
+	double score;			// Higher is better
+};
+
+// World a worker simulates candidate moves on, with room for its block transformations
+struct SolverFork
+{
+	PhysicsWorld world;
+	std::vector<btTransform> trans;
+	std::vector<btTransform> start;
+};
+
+// Ranks moves by forking the tower - each worker restores a snapshot of it into a world of its own
+// and plays a candidate removal and placement forward, until the time budget runs out
+class TowerSolver
+{
+	WorkerPool pool;
+	SolverFork* forks;			// One per worker
+	int forkNo;
+	int stepRate;
+	int blockNo;
+	int layerWidth;
+
+	double lastRate;			// Candidates simulated per second in the last solve
+
+	void simulate(PhysicsWorld& world, btTransform* trans, btTransform* start, SolverMove& move, double towerHeight);
+
+public:
+	TowerSolver(int threadNo, int newStepRate, int newBlockNo, int newLayerWidth);
+	~TowerSolver();
+	void findMoves(const WorldSnapshot& snapshot, double towerHeight, std::vector<SolverMove>& moves);
+	int solve(const WorldSnapshot& snapshot, double towerHeight, double budget, std::vector<SolverMove>& moves);
+	void playMove(PhysicsWorld& world, SolverMove& move, double towerHeight);
+	double measureDrift(const WorldSnapshot& snapshot);
+	int getThreadNo();
+	double getRate();
+};
\ No newline at end of file
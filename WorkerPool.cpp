@@ -0,0 +1,100 @@
+#include "BlockTowerTools.h"
+
+WorkerPool::WorkerPool(int threadNo)
+{
+	// Use every hardware thread if no thread count is given
+	if ( threadNo <= 0 )
+		threadNo = std::max(1u, std::thread::hardware_concurrency());
+
+	taskNo = 0;
+	nextTask = 0;
+	busyWorkers = 0;
+	batch = 0;
+	stopping = false;
+
+	// The calling thread takes part in every batch, so one fewer worker is needed
+	for (int i=1; i<threadNo; i++)
+		workers.push_back(std::thread(&WorkerPool::workerLoop, this));
+}
+
+
+WorkerPool::~WorkerPool()
+{
+	/* Wake all workers and wait for them to exit */
+
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (size_t i=0; i<workers.size(); i++)
+		workers[i].join();
+}
+
+
+int WorkerPool::getThreadNo() { return int(workers.size())+1; }
+
+
+void WorkerPool::run(int count, const std::function<void(int)>& newTask)
+{
+	/* Run task for every index from 0 to count-1, returning once all have finished */
+
+	if ( workers.empty() ) {
+		for (int i=0; i<count; i++)
+			newTask(i);
+		return;
+	}
+
+	// Post batch to workers
+	{
+		std::unique_lock<std::mutex> lock(poolMutex);
+		task = newTask;
+		taskNo = count;
+		nextTask = 0;
+		busyWorkers = int(workers.size());
+		batch++;
+	}
+	workReady.notify_all();
+
+	runTasks();
+
+	// Wait for workers to finish their last claimed tasks
+	std::unique_lock<std::mutex> lock(poolMutex);
+	workDone.wait(lock, [this]{ return busyWorkers == 0; });
+}
+
+
+void WorkerPool::workerLoop()
+{
+	/* Sleep until a batch is posted, then help run it */
+
+	unsigned long lastBatch = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(poolMutex);
+			workReady.wait(lock, [this, lastBatch]{ return stopping || batch != lastBatch; });
+			if ( stopping )
+				return;
+			lastBatch = batch;
+		}
+
+		runTasks();
+
+		{
+			std::unique_lock<std::mutex> lock(poolMutex);
+			if ( --busyWorkers == 0 )
+				workDone.notify_one();
+		}
+	}
+}
+
+
+void WorkerPool::runTasks()
+{
+	/* Claim and run tasks from the current batch until none are left */
+
+	for (int i = nextTask++; i < taskNo; i = nextTask++)
+		task(i);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+class WorkerPool
+{
+	std::vector<std::thread> workers;		// Threads that run tasks alongside the calling thread
+
+	std::mutex poolMutex;					// Guards the fields below against sleeping workers
+	std::condition_variable workReady;		// Signalled when a new batch of tasks is posted
+	std::condition_variable workDone;		// Signalled when the last worker finishes a batch
+	std::function<void(int)> task;			// Task for the current batch, given a task index
+	int taskNo;								// Number of tasks in the current batch
+	std::atomic<int> nextTask;				// Index of the next task to be claimed
+	int busyWorkers;						// Workers still running the current batch
+	unsigned long batch;					// Incremented for every new batch of tasks
+	bool stopping;							// Set when the pool is being destroyed
+
+	void workerLoop();
+	void runTasks();
+
+public:
+	WorkerPool(int threadNo);
+	~WorkerPool();
+	int getThreadNo();
+	void run(int count, const std::function<void(int)>& newTask);
+};
\ No newline at end of file
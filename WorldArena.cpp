@@ -0,0 +1,77 @@
+#include "BlockTowerPhysics.h"
+
+WorldArena::WorldArena(size_t chunkSize)
+{
+	defaultChunkSize = chunkSize;
+	chunkIndex = 0;
+	offset = 0;
+}
+
+
+WorldArena::~WorldArena()
+{
+	for (size_t i=0; i<chunks.size(); i++)
+		delete[] chunks[i];
+}
+
+
+void* WorldArena::allocate(size_t size, size_t alignment)
+{
+	/* Hand out aligned memory from the current chunk, moving to a new chunk when full */
+
+	alignment = std::max(alignment, size_t(16));	// Bullet types expect 16-byte alignment
+
+	while ( chunkIndex < chunks.size() ) {
+		size_t base = reinterpret_cast<size_t>(chunks[chunkIndex]);
+		size_t start = (base+offset+alignment-1)/alignment*alignment-base;
+		if ( start+size <= chunkSizes[chunkIndex] ) {
+			offset = start+size;
+			return chunks[chunkIndex]+start;
+		}
+		// Move onto next chunk, left over from before a reset
+		chunkIndex++;
+		offset = 0;
+	}
+
+	// Add chunk large enough for the allocation
+	size_t chunkSize = std::max(defaultChunkSize, size+alignment);
+	chunks.push_back(new char[chunkSize]);
+	chunkSizes.push_back(chunkSize);
+	chunkIndex = chunks.size()-1;
+	offset = 0;
+
+	return allocate(size, alignment);
+}
+
+
+void WorldArena::reserve(size_t size)
+{
+	/* Make sure the arena can hold the given number of bytes in total, without adding chunks later */
+
+	size_t capacity = 0;
+	for (size_t i=0; i<chunkSizes.size(); i++)
+		capacity += chunkSizes[i];
+
+	if ( capacity < size ) {
+		chunks.push_back(new char[size-capacity]);
+		chunkSizes.push_back(size-capacity);
+	}
+}
+
+
+void WorldArena::reset()
+{
+	/* Make all memory available again - objects must already have been destroyed */
+
+	chunkIndex = 0;
+	offset = 0;
+}
+
+
+size_t WorldArena::getUsedBytes()
+{
+	size_t used = offset;
+	for (size_t i=0; i<chunkIndex && i<chunks.size(); i++)
+		used += chunkSizes[i];
+	return used;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+class WorldArena
+{
+	std::vector<char*> chunks;		// Memory chunks, kept for reuse after a reset
+	std::vector<size_t> chunkSizes;
+	size_t chunkIndex;				// Chunk currently being allocated from
+	size_t offset;					// Position of next free byte in current chunk
+	size_t defaultChunkSize;		// Size of chunks added when the arena runs out of space
+
+	WorldArena(const WorldArena&);
+	WorldArena& operator=(const WorldArena&);
+
+public:
+	WorldArena(size_t chunkSize);
+	~WorldArena();
+
+	void* allocate(size_t size, size_t alignment);
+	void reserve(size_t size);
+	void reset();
+	size_t getUsedBytes();
+
+	// Construct object in arena memory - must be released with destroy, never delete
+	template<class T, class... Args> T* create(Args&&... args)
+	{
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// Construct object in the memory of one already destroyed, so rebuilding it takes no more space
+	template<class T, class... Args> T* createIn(void* memory, Args&&... args)
+	{
+		if ( !memory )
+			memory = allocate(sizeof(T), alignof(T));
+		return new (memory) T(std::forward<Args>(args)...);
+	}
+
+	template<class T> T** createArray(int count)
+	{
+		T** array = static_cast<T**>(allocate(sizeof(T*)*count, alignof(T*)));
+		std::fill(array, array+count, (T*)0);
+		return array;
+	}
+
+	template<class T> void destroy(T* object)
+	{
+		if ( object )
+			object->~T();
+	}
+};
\ No newline at end of file
@@ -0,0 +1,40 @@
+// Dynamic state of a single rigid body
+struct BodyState
+{
+	btTransform worldTrans;						// Current transformation
+	btTransform interpolationTrans;				// Transformation at start of last step, for interpolation
+	btTransform graphicsTrans;					// Interpolated transformation held by motion state
+	btVector3 linearVelocity;
+	btVector3 angularVelocity;
+	btVector3 interpolationLinearVelocity;
+	btVector3 interpolationAngularVelocity;
+	btVector3 totalForce;						// Forces applied since last step
+	btVector3 totalTorque;
+	int activationState;						// Active, sleeping etc.
+	btScalar deactivationTime;					// Time spent below sleeping thresholds
+};
+
+// Cached contact points between two bodies, including solver impulses used for warm-starting
+struct ManifoldState
+{
+	int body0;			// Block index of first body (-1 for surface)
+	int body1;			// Block index of second body
+	int contactNo;
+	btManifoldPoint contacts[MANIFOLD_CACHE_SIZE];
+};
+
+// Complete dynamic state of a physics world, restorable without any allocation
+class WorldSnapshot
+{
+public:
+	std::vector<BodyState> bodies;			// State of each block
+	std::vector<ManifoldState> manifolds;	// Storage for contact manifolds, grown as needed
+	int manifoldNo;							// Number of manifolds in use
+
+	btScalar localTime;						// Time accumulated towards the next internal step
+	unsigned long stepCount;
+	int droppedSubSteps;
+	unsigned int seed;						// Seed that chose the block shapes
+
+	WorldSnapshot() : manifoldNo(0), localTime(0), stepCount(0), droppedSubSteps(0), seed(0) {}
+};
\ No newline at end of file
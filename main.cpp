@@ -13,22 +13,16 @@
 
 #define KEY_e 101
 #define KEY_h 104
-
-// Game phases
-#define PHASE_CHOOSE 0
-#define PHASE_SELECT 1
-#define PHASE_REMOVE 2
-#define PHASE_RAISE 3
-#define PHASE_PLACE 4
-#define PHASE_CHECK 5
-#define PHASE_COLLAPSE 6
+#define KEY_t 116
 
 // Camera adjustment factors
 #define ZOOM_FACTOR 0.4
 #define SHIFT_FACTOR 0.1
 #define TURN_FACTOR 1.0
 
-#define H_SPAN 60	// Horizontal spanning factor for play area
+#define STEP_RATE 120	// Internal physics steps per second (e.g. 120 or 240)
+
+#define HEADLESS_FRAME_TICKS 2	// Physics ticks per off-screen frame, for 60 frames per second of game time
 
 // Viewing window struct
 typedef struct {
@@ -48,24 +42,29 @@ typedef struct {
 glutWindow win;				// Viewing window
 
 PhysicsWorld physWorld;		// Physics simulation object
+GameSession session;		// Rules of the game, played on physWorld
+PhysicsThread physThread;	// Ticks the session on its own thread - declared after both, so it stops first
 
 Camera cam = Camera(20,40,-45,15);	//	Camera object
-int phase = PHASE_CHOOSE;			// Initial phase
-
-int drawCount = 0;					// For countdown of draw cycles
-
-GLdouble mouseRay[3] = {0,0,0};		// 3D coordinates corresponding to the mouse cursor
-GLdouble objectSelect[3] = {0,0,0};	// mouseRay coordinates relative to a selected block
-GLdouble removePlaneY = 0;			// Height of horizontal plane for moving a selected block
-
-GLuint stencilIndex = 0;	// Index of an object displayed on-screen
-GLint objectIndex = -2;		// Index of a block in the physics world
-
-btTransform boxTrans[BLOCK_NO];	 // Array for transformations of blocks in the physics world
-
-int turnNo = 0;										// Number of turns taken in the current game
-int maxTurnNo = 0;									// Highest number of turns ever taken
-GLdouble towerHeight = floor(BLOCK_NO/3.0)*1.52;	// Height of tower up to the highest complete layer
+BlockRenderer renderer;				// Draws blocks from cached meshes
+FrameScheduler scheduler;			// Decides when frames are drawn
+Overlay overlay;					// Text and planes drawn over the scene
+FrameProfiler profiler;				// Times each stage of display()
+float renderTime = 0;				// Time spent drawing a frame, smoothed, in ms
+int frameDrawCalls = 0;				// Draw calls issued by the renderer in the last frame
+double idleReportTime = 0;			// Seconds to run before reporting idle CPU usage and quitting (0 to keep running)
+double idleCpuSum = 0;				// CPU usage summed over the seconds in which nothing on screen could change
+int idleSecondNo = 0;
+
+int shownPhase = PHASE_CHOOSE;		// Phase the camera was last moved to suit
+unsigned long shownGameNo = 0;		// Game the camera was last reset for
+
+InputLog inputLog;				// Every change made to the physics world, when recording
+const char* recordPath = 0;		// File to save the recording to on exit (0 for no recording)
+
+const PhysicsFrame* physFrame;	// Latest state published by the physics thread
+const btTransform* boxTrans;	// Array for transformations of blocks in the physics world, from physFrame
+const GameState* game;			// State of the game, from physFrame
 
 // 2D coordinates of mouse, relative to viewing window
 int mouseX = -1;
@@ -74,88 +73,78 @@ int mouseY = -1;
 int buttonPress = -1;	// Current mouse button being pressed (-1 means no button)
 
 boolean helpOn = true;	// Whether to display help bar or not
+boolean profileOn = false;	// Whether to display frame stage timings
+boolean readbackPicking = false;	// Pick with a depth readback instead of casting a ray, for comparison
 
-void getMouseSelection(int x, int y)
+void getMouseSelection(int x, int y, GLdouble* point)
 {
 	/* Get 3D world coordinates corresponding to mouse cursor's target */
 
-	// Get current matrices and viewport coordinates
-	GLdouble modelview[16];
-	GLdouble projection[16];
-	GLint viewport[4];
+	// Get depth of cursor's position
+	GLfloat winZ;
+	GLint winY = cam.getViewport()[3] - y;
+	glReadPixels(x, winY, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ);
 
-	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-	glGetDoublev(GL_PROJECTION_MATRIX, projection);
-	glGetIntegerv(GL_VIEWPORT, viewport);
+	// Un-project, i.e. shoot a ray from camera, through cursor to cursor target
+	cam.unproject(x, winY, winZ, point);
+}
 
-	// Get 3D world coordinates of cursor's position
-	GLfloat winX, winY, winZ;
-	winX = (float) x;
-	winY = (float) (viewport[3] - y);
-	glReadPixels(x, int(winY), 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ);
 
-	// Un-project, i.e. shoot a ray from camera, through cursor to cursor target
-	gluUnProject(
-		winX, winY, winZ,
-		modelview, projection, viewport,
-		&mouseRay[0], &mouseRay[1], &mouseRay[2]
-	);
+void getMouseRay(int x, int y, btVector3& rayFrom, btVector3& rayTo)
+{
+	/* Get ray from the near to the far clipping plane through the mouse cursor, without reading back any pixels */
 
-	/* Get current stencil index to identify cursor target */
+	GLdouble nearPoint[3], farPoint[3];
+	cam.getRay(x, y, nearPoint, farPoint);
 
-	glReadPixels(x, int(winY), 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_INT, &stencilIndex);
+	rayFrom.setValue(nearPoint[0], nearPoint[1], nearPoint[2]);
+	rayTo.setValue(farPoint[0], farPoint[1], farPoint[2]);
 }
 
 
-void setPhase(int* currentPhase, int newPhase, int newDrawCount=0)
+boolean mouseInWindow()
 {
-	/* Set phase and any consistent settings related to it */
+	/* Check that the mouse is over the viewing window */
+
+	return std::min(mouseX,mouseY) > 0 && mouseX < win.width && mouseY < win.height;
+}
+
+
+void sendPointer()
+{
+	/* Tell the game where the mouse points, through the camera as last set up */
+
+	btVector3 rayFrom(0,0,0), rayTo(0,0,0);
+	if ( mouseInWindow() )
+		getMouseRay(mouseX, mouseY, rayFrom, rayTo);
+
+	btVector3 eye(cam.getEyeX(), cam.getEyeY(), cam.getEyeZ());
+	physThread.setPointer(mouseInWindow(), rayFrom, rayTo, eye, cam.getAngleX() != cam.getActualAngleX());
+}
+
+
+void followPhase(int newPhase)
+{
+	/* Move the camera to suit a new phase of the game */
 
 	switch ( newPhase ) {
 	case PHASE_CHOOSE:
-		*currentPhase = PHASE_CHOOSE;
-		cam.setDistance(40);
-		cam.setAngleY(15);
-		objectIndex = -2;
-		break;
 	case PHASE_REMOVE:
-		*currentPhase = PHASE_REMOVE;
+	case PHASE_SELECT:
+	case PHASE_CHECK:
 		cam.setDistance(40);
 		cam.setAngleY(15);
-		{
-			btVector3 boxOrigin = boxTrans[objectIndex].getOrigin();
-			objectSelect[0] = mouseRay[0]-boxOrigin.getX();
-			objectSelect[1] = mouseRay[1]-boxOrigin.getY();
-			objectSelect[2] = mouseRay[2]-boxOrigin.getZ();
-		}
 		break;
 	case PHASE_RAISE:
-		*currentPhase = PHASE_RAISE;
-		cam.setHeight(towerHeight);
-		cam.setDistance(40);
-		cam.setAngleY(15);
-		objectSelect[1] = 0;
-		break;
-	case PHASE_SELECT:
-		*currentPhase = PHASE_SELECT;
+		cam.setHeight(game->towerHeight);
 		cam.setDistance(40);
 		cam.setAngleY(15);
 		break;
 	case PHASE_PLACE:
-		*currentPhase = PHASE_PLACE;
 		cam.setDistance(20);
 		cam.setAngleY(25);
-		removePlaneY = towerHeight+4;
-		objectSelect[0] = 0;
-		objectSelect[2] = 0;
-		break;
-	case PHASE_CHECK:
-		*currentPhase = PHASE_CHECK;
-		cam.setDistance(40);
-		cam.setAngleY(15);
 		break;
 	case PHASE_COLLAPSE:
-		*currentPhase = PHASE_COLLAPSE;
 		cam.setHeight(10);
 		cam.setAngleY(15);
 		break;
@@ -163,595 +152,246 @@ void setPhase(int* currentPhase, int newPhase, int newDrawCount=0)
 		break;
 	}
 
-	drawCount = newDrawCount;	// Set draw countdown, or reset to 0
+	shownPhase = newPhase;
 }
 
 
-void resetGame()
+void saveRecording()
 {
-	/* Reset global variables for new game */
+	/* Write out the session's recording, called on exit */
 
-	setPhase(&phase, PHASE_CHOOSE);
-	cam.setAngleX(floor(cam.getAngleX()/45)*45);
-	cam.setHeight(20);
-	turnNo = 0;
-	towerHeight = floor(BLOCK_NO/3.0)*1.52;
-
-	physWorld.resetWorld();		// Restart simulation
+	physThread.stop();		// Recording must not change while being saved
+	physWorld.stopRecording();
+	if ( !inputLog.save(recordPath) )
+		fprintf(stderr, "Could not save recording to %s\n", recordPath);
 }
 
 
-void textOverlay(char* string, int length, GLfloat x, GLfloat y, void *font=GLUT_BITMAP_HELVETICA_18)
+void buildOverlay()
 {
-	/* Draw text overlay */
-
-	// Scale mouse coordinates
-	x = (x/win.width-0.5)*1.11;
-	y = (y/win.height-0.5)*0.83;
-
-	glPushMatrix();
-		// Position text on virtual plane such that view is normal to plane
-		glRasterPos3f(
-			-(cam.getEyeY()-cam.getViewY())*sin(cam.getActualAngleX()*PI/180)*y+cam.getActualDistance()*cos(cam.getActualAngleX()*PI/180)*x,
-			cam.getViewY()+cam.getActualDistance()*cos(cam.getActualAngleY()*PI/180)*y,
-			-(cam.getEyeY()-cam.getViewY())*cos(cam.getActualAngleX()*PI/180)*y-cam.getActualDistance()*sin(cam.getActualAngleX()*PI/180)*x
-		);
-		for ( int i=0; i<length; i++ )
-			glutBitmapCharacter(font, string[i]);
-	glPopMatrix();
-}
+	/* Lay out text and plane overlay features for the current phase, score and help setting */
 
+	overlay.begin();
 
-void planeOverlay(GLdouble x1, GLdouble y1, GLdouble x2, GLdouble y2)
-{
-	/* Draw rectangular plane overlay */
-
-	// Scale mouse coordinates
-	x1 = (x1/win.width-0.5)*1.11;
-	y1 = (y1/win.height-0.5)*0.83;
-	x2 = (x2/win.width-0.5)*1.11;
-	y2 = (y2/win.height-0.5)*0.83;
-
-	// Get co-ordinates for vertices of plane, such that view is orthogonal to plane
-	GLfloat vertices[10] = {
-			cam.getViewY()+cam.getActualDistance()*cos(cam.getActualAngleY()*PI/180)*y1,
-
-			-(cam.getEyeY()-cam.getViewY())*sin(cam.getActualAngleX()*PI/180)*y1+cam.getActualDistance()*cos(cam.getActualAngleX()*PI/180)*x1,
-			-(cam.getEyeY()-cam.getViewY())*cos(cam.getActualAngleX()*PI/180)*y1-cam.getActualDistance()*sin(cam.getActualAngleX()*PI/180)*x1,
-
-			-(cam.getEyeY()-cam.getViewY())*sin(cam.getActualAngleX()*PI/180)*y1+cam.getActualDistance()*cos(cam.getActualAngleX()*PI/180)*x2,
-			-(cam.getEyeY()-cam.getViewY())*cos(cam.getActualAngleX()*PI/180)*y1-cam.getActualDistance()*sin(cam.getActualAngleX()*PI/180)*x2,
-
-			cam.getViewY()+cam.getActualDistance()*cos(cam.getActualAngleY()*PI/180)*y2,
-
-			-(cam.getEyeY()-cam.getViewY())*sin(cam.getActualAngleX()*PI/180)*y2+cam.getActualDistance()*cos(cam.getActualAngleX()*PI/180)*x1,
-			-(cam.getEyeY()-cam.getViewY())*cos(cam.getActualAngleX()*PI/180)*y2-cam.getActualDistance()*sin(cam.getActualAngleX()*PI/180)*x1,
-
-			-(cam.getEyeY()-cam.getViewY())*sin(cam.getActualAngleX()*PI/180)*y2+cam.getActualDistance()*cos(cam.getActualAngleX()*PI/180)*x2,
-			-(cam.getEyeY()-cam.getViewY())*cos(cam.getActualAngleX()*PI/180)*y2-cam.getActualDistance()*sin(cam.getActualAngleX()*PI/180)*x2,
-	};
-
-	// Draw plane
-	glPushMatrix();
-		glBegin(GL_TRIANGLE_STRIP);
-			glVertex3f(vertices[1], vertices[0], vertices[2]);
-			glVertex3f(vertices[3], vertices[0], vertices[4]);
-			glVertex3f(vertices[6], vertices[5], vertices[7]);
-			glVertex3f(vertices[8], vertices[5], vertices[9]);
-		glEnd();
-	glPopMatrix();
-}
+	int phase = game->phase;
+	boolean showMessage = game->messageTime > 0;
+	char text[32];
 
+	if ( phase != PHASE_COLLAPSE ) {
+		// Display Hi-Score and Score
+		overlay.setColour(1,1,1);
+		sprintf(text, "Hi-Score: %d", game->maxTurnNo);
+		overlay.addText(text, 14, win.height-24);
+		sprintf(text, "Score: %d", game->score);
+		overlay.addText(text, 14, win.height-48);
+		if ( helpOn ) {
+			// Display empty help bar
+			overlay.addText("H: Toggle help", 5, 56, OVERLAY_FONT_SMALL);
+			overlay.setColour(1,1,1,0.5);
+			overlay.addPlane(0, 0, win.width, 50);
+		}
+		else
+			overlay.addText("H: Toggle help", 5, 5, OVERLAY_FONT_SMALL);
+	}
 
-void drawSolidBox(GLfloat x, GLfloat y, GLfloat z)
-{
-	/* Draw a solid box representing a wooden block */
-
-	glBegin(GL_TRIANGLES);
-		glColor3f(0.95,0.80,0.57);	// Set colour to woodgrain
-		glNormal3d(-1,0,0);		// Direction of normal to surface - for correct lighting
-		// Vertices for surface
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y,-z);
-		glVertex3f(-x, y, z);
-
-		glNormal3d(1,0,0);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f( x, y, z);
-
-		glColor3f(0.90,0.80,0.57);
-		glNormal3d(0,-1,0);
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f( x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x,-y, z);
-
-		glNormal3d(0,1,0);
-		glVertex3f(-x, y,-z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f( x, y, z);
-
-		glColor3f(0.90,0.80,0.67);
-		glNormal3d(0,0,-1);
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x, y,-z);
-		glVertex3f( x,-y,-z);
-		glVertex3f(-x, y,-z);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x, y,-z);
-
-		glNormal3d(0,0,1);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x,-y, z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y, z);
-	glEnd();
-}
+	if ( phase == PHASE_CHOOSE ) {
+		if ( showMessage ) {
+			// Display message while it counts down
+			overlay.setColour(1,1,1);
+			overlay.addText("Okay!", win.width/2-25, win.height/2);
+		}
+		if ( helpOn ) {
+			// Display help text for current phase
+			overlay.setColour(0,0,0);
+			overlay.addText("Choose a block", 10, 30);
+			overlay.addText("W: push block; S: pull block; E: rotate camera; Space: choose block", 10, 10, OVERLAY_FONT_SMALL);
+		}
+	}
+	else if ( phase == PHASE_REMOVE ) {
+		if ( helpOn ) {
+			overlay.setColour(0,0,0);
+			overlay.addText("Remove block", 10, 30);
+			overlay.addText("W: raise block (when removed); A/D: rotate block; Release mouse to drop block", 10, 10, OVERLAY_FONT_SMALL);
+		}
+	}
+	else if ( phase == PHASE_SELECT ) {
+		if ( showMessage ) {
+			overlay.setColour(1,1,1);
+			overlay.addText("Try again", win.width/2-40, win.height/2);
+		}
+		if ( helpOn ) {
+			overlay.setColour(0,0,0);
+			overlay.addText("Select block", 10, 30);
+			overlay.addText("W: push block; S: pull block; E: rotate camera; Space: check placement; Use the mouse to select the block", 10, 10, OVERLAY_FONT_SMALL);
+		}
+	}
+	else if ( phase == PHASE_PLACE ) {
+		if ( helpOn ) {
+			overlay.setColour(0,0,0);
+			overlay.addText("Place block", 10, 30);
+			overlay.addText("W: raise block; S: lower block; A/D: rotate block; E: rotate camera; Release mouse to drop block", 10, 10, OVERLAY_FONT_SMALL);
+		}
+	}
+	else if ( phase == PHASE_CHECK ) {
+		overlay.setColour(1,1,1);
+		overlay.addText("Checking...", win.width/2-40, win.height/2);
+	}
+	else if ( phase == PHASE_COLLAPSE ) {
+		// Display 'GAME OVER' overlay
+		overlay.setColour(1,1,1,0.5);
+		overlay.addPlane(win.width/2-120, win.height/2-50, win.width/2+120, win.height/2+80);
 
+		overlay.setColour(0,0,0);
+		overlay.addText("GAME OVER", win.width/2-55, win.height/2+48);
 
-void drawLineBox(float x, float y, float z)
-{
-	/* Draw box formed of lines */
-
-	glDisable(GL_LIGHTING);		// Disable lighting temporarily
-
-	glBegin(GL_LINES);
-		glLineWidth(5);
-
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y,-z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f( x, y, z);
-
-		glVertex3f(-x,-y,-z);
-		glVertex3f( x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f( x,-y, z);
-		glVertex3f(-x, y,-z);
-		glVertex3f( x, y,-z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x, y, z);
-
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x, y,-z);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x, y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y, z);
-	glEnd();
+		sprintf(text, "Final score: %d", game->score);
+		if ( game->turnNo > game->maxTurnNo )
+			overlay.setColour(0.8,0,0);
+		overlay.addText(text, win.width/2-55, win.height/2+12);
+		if ( game->turnNo > game->maxTurnNo )
+			overlay.setColour(0,0,0);
 
-	glEnable(GL_LIGHTING);
-}
+		if ( !showMessage )
+			overlay.addText("Press space to play again", win.width/2-105, win.height/2-24);
+	}
 
+	if ( profileOn ) {
+		// Display stage timings beside the score
+		GLfloat left = 160;
+		GLfloat top = win.height-20;
+		overlay.setColour(0,0,0,0.5);
+		overlay.addPlane(left-6, top-14*STAGE_NO-8, left+214, top+16);
+		overlay.setColour(1,1,1);
+		overlay.addText("stage         p50     p95     p99 ms", left, top, OVERLAY_FONT_SMALL);
+		for ( int i = 0; i < STAGE_NO; i++ ) {
+			sprintf(text, "%-10s", FrameProfiler::getStageName(i));
+			overlay.addText(text, left, top-14*(i+1), OVERLAY_FONT_SMALL);
+			for ( int j = 0; j < 3; j++ ) {
+				sprintf(text, "%7.2f", profiler.getPercentile(i, j));
+				overlay.addText(text, left+70+j*48, top-14*(i+1), OVERLAY_FONT_SMALL);
+			}
+		}
+	}
 
-void drawBox(GLfloat x, GLfloat y, GLfloat z)
-{
-	/* Draw non-specific box */
-
-	glBegin(GL_TRIANGLES);
-		glNormal3d(-1,0,0);
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y,-z);
-		glVertex3f(-x, y, z);
-
-		glNormal3d(1,0,0);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f( x, y, z);
-
-		glNormal3d(0,-1,0);
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f( x,-y,-z);
-		glVertex3f(-x,-y, z);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x,-y, z);
-
-		glNormal3d(0,1,0);
-		glVertex3f(-x, y,-z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x, y,-z);
-		glVertex3f( x, y, z);
-
-		glNormal3d(0,0,-1);
-		glVertex3f(-x,-y,-z);
-		glVertex3f(-x, y,-z);
-		glVertex3f( x,-y,-z);
-		glVertex3f(-x, y,-z);
-		glVertex3f( x,-y,-z);
-		glVertex3f( x, y,-z);
-
-		glNormal3d(0,0,1);
-		glVertex3f(-x,-y, z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x,-y, z);
-		glVertex3f(-x, y, z);
-		glVertex3f( x,-y, z);
-		glVertex3f( x, y, z);
-	glEnd();
+	overlay.end();
 }
 
 
 void display()
 {
-	/* Initialize variables */
-
-	btQuaternion boxRotate[BLOCK_NO];
-	btVector3 boxOrigin = boxTrans[std::max(0,objectIndex)].getOrigin();
-	boolean towerStanding = false;
-	boolean blockFallen = false;
-	int nextPhase = phase;
-
-	/* Step physics world and collection information */
-
-	physWorld.stepWorld(boxTrans);
+	/* Collect latest physics world and game information, without waiting for a tick */
+
+	profiler.beginFrame();
+	physFrame = &physThread.acquireFrame();
+	boxTrans = physFrame->trans.data();
+	game = &physFrame->game;
+	int phase = game->phase;
+	int objectIndex = game->objectIndex;
+
+	std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+	profiler.setStage(STAGE_PHYSICS, physFrame->stepTime);
+	profiler.mark(STAGE_SYNC);
+
+	/* Move the camera to suit the game */
+
+	if ( game->gameNo != shownGameNo ) {
+		// New game - square up the view of the tower
+		cam.setAngleX(floor(cam.getAngleX()/45)*45);
+		cam.setHeight(20);
+		shownGameNo = game->gameNo;
+	}
+	if ( phase != shownPhase )
+		followPhase(phase);
 
-	/* Clear buffers and load the identity matrix for new scene */
+	/* Clear buffers for new scene */
 
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
-	glLoadIdentity();
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
 	/* Set up camera */
 
 	cam.updateView();	// Update camera coordinates
 
-	gluLookAt(
-		cam.getEyeX(), cam.getEyeY(), cam.getEyeZ(),	// Camera position
-		cam.getViewX(), cam.getViewY(), cam.getViewZ(),	// Point being observed
-		cam.getUpX(), cam.getUpY(), cam.getUpZ()		// Direction of up, relative to camera
-	);
-
-	/* If currently moving block, get current mouse world coordinates on a given plane */
-
-	if ( phase == PHASE_REMOVE ) {
-		if ( boxOrigin.getY() > towerHeight )
-			setPhase(&phase, PHASE_RAISE);
-		else {
-			// Draw temporary box, containing horizontal plane and restrictive planes
-			glPushMatrix();
-				if ( removePlaneY > cam.getEyeY() )
-					glTranslatef(0,-100,0);
-				else
-					glTranslatef(0,removePlaneY*2+100,0);
-				drawSolidBox(H_SPAN,removePlaneY+100,H_SPAN);
-			glPopMatrix();
-
-			// Get mouse coordinates on horizontal plane
-			if ( std::min(mouseX,mouseY) > 0 && mouseX < win.width && mouseY < win.height )
-				getMouseSelection(mouseX, mouseY);
-			mouseRay[1] = removePlaneY;
-
-			// Erase box
-			glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-		}
-	}
-
-	if ( phase == PHASE_RAISE ) {
-		if ( boxOrigin.getY() >= towerHeight+4 )
-			setPhase(&phase, PHASE_PLACE);
-		else {
-			// Draw temporary vertical plane
-			glPushMatrix();
-				glTranslatef(boxOrigin.getX(),0,boxOrigin.getZ());
-				glBegin(GL_TRIANGLE_STRIP);
-					glVertex3f(-cam.getEyeZ()*win.z_far, win.z_far, cam.getEyeX()*win.z_far);
-					glVertex3f( cam.getEyeZ()*win.z_far, win.z_far,-cam.getEyeX()*win.z_far);
-					glVertex3f(-cam.getEyeZ()*win.z_far,-win.z_far, cam.getEyeX()*win.z_far);
-					glVertex3f( cam.getEyeZ()*win.z_far,-win.z_far,-cam.getEyeX()*win.z_far);
-				glEnd();
-			glPopMatrix();
-
-			// Get mouse coordinates on plane
-			if ( std::min(mouseX,mouseY) > 0 && mouseX < win.width && mouseY < win.height )
-				getMouseSelection(mouseX, mouseY);
-
-			// Erase plane
-			glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-		}
-	}
+	glLoadMatrixd(cam.getModelview());	// View matrix, kept by the camera for unprojecting the mouse
 
-	if ( phase == PHASE_PLACE ) {
-		// Draw temporary box, containing horizontal plane and restrictive planes
-		glPushMatrix();
-			if ( removePlaneY > cam.getEyeY() )
-				glTranslatef(0,-100,0);
-			else
-				glTranslatef(0,removePlaneY*2+100,0);
-			drawSolidBox(H_SPAN/2,removePlaneY+100,H_SPAN/2);
-		glPopMatrix();
+	sendPointer();		// The mouse points somewhere new if the camera has moved
 
-		// Get mouse coordinates on horizontal plane
-		if ( std::min(mouseX,mouseY) > 0 && mouseX < win.width && mouseY < win.height )
-			getMouseSelection(mouseX, mouseY);
-		mouseRay[1] = removePlaneY;
-
-		// Erase box
-		glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-	}
+	profiler.mark(STAGE_SETUP);
 
 	/* Draw physics world plane */
 
-	glPushMatrix();
-		glTranslatef(0,physWorld.getSurfaceHeight(),0);
-		glStencilFunc(GL_ALWAYS, 1, -1);		// Stencil index for plane
-		glColor3f(0.8,0.8,0.8);
-		glBegin(GL_TRIANGLE_STRIP);
-			glNormal3d(0,1,0);
-			glVertex3f( 10,0,-10);
-			glVertex3f( 10,0, 10);
-			glVertex3f(-10,0,-10);
-			glVertex3f(-10,0, 10);
-		glEnd();
-		glColor3f(0,0.5,1);
-		glBegin(GL_TRIANGLE_STRIP);
-			glNormal3d(0,1,0);
-			glVertex3f( H_SPAN,-0.1,-H_SPAN);
-			glVertex3f( H_SPAN,-0.1, H_SPAN);
-			glVertex3f(-H_SPAN,-0.1,-H_SPAN);
-			glVertex3f(-H_SPAN,-0.1, H_SPAN);
-		glEnd();
-		glColor3f(0,0.4,1);
-		glBegin(GL_TRIANGLE_STRIP);
-			glNormal3d(0,1,0);
-			glVertex3f( win.z_far/2,-0.2,-win.z_far/2);
-			glVertex3f( win.z_far/2,-0.2, win.z_far/2);
-			glVertex3f(-win.z_far/2,-0.2,-win.z_far/2);
-			glVertex3f(-win.z_far/2,-0.2, win.z_far/2);
-		glEnd();
-	glPopMatrix();
+	renderer.drawFloor();
 
 	/* Draw physics world blocks using given transformations */
 
-	for ( int i=0; i<BLOCK_NO; i++ ) {
-		boxRotate[i] = boxTrans[i].getRotation();
-		glPushMatrix();
-			// Check location of block to see if tower is standing
-			if ( boxTrans[i].getOrigin().getY() > towerHeight-1.52 && !towerStanding )
-				if ( physWorld.checkContact(i) )
-					towerStanding = true;
-			if ( !physWorld.isActive(i) && i != objectIndex && !blockFallen )
-				if ( !physWorld.checkContact(i) )
-					blockFallen = true;
-
-			if ( boxTrans[i].getOrigin().getX() > H_SPAN*1.1 || boxTrans[i].getOrigin().getZ() > H_SPAN*1.1 )
-				physWorld.centerObject(i);	// If block is out of play area, force it back
-
-			glTranslatef(
-				boxTrans[i].getOrigin().getX(),
-				boxTrans[i].getOrigin().getY(),
-				boxTrans[i].getOrigin().getZ()
-			);
-			glRotatef(
-				boxRotate[i].getAngle()/PI*180,
-				boxRotate[i].getAxis().getX(),
-				boxRotate[i].getAxis().getY(),
-				boxRotate[i].getAxis().getZ()
-			);
-
-			glColor3f(0.90,0.80,0.57);
-			if ( phase == PHASE_CHOOSE || phase == PHASE_SELECT )
-				glStencilFunc(GL_ALWAYS, i+2, -1);		// Set stencil index for block
-
-			drawSolidBox(
-				physWorld.getBoxExtents().getX(),
-				physWorld.getBoxExtents().getY(),
-				physWorld.getBoxExtents().getZ()
-			);
-		glPopMatrix();
-	}
+	btVector3 boxExtents = physWorld.getBoxExtents();
+	renderer.setInstances(boxTrans, physWorld.getBlockNo());
+	renderer.drawBlocks(boxExtents);
+	profiler.mark(STAGE_SCENE);
 
-	/* If not moving a block, get current mouse target coordinates */
+	/* If not moving a block, pick from the depth buffer instead of the game casting a ray */
 
-	if ( ( phase == PHASE_CHOOSE || phase == PHASE_SELECT ) &&
-		std::min(mouseX,mouseY) > 0 &&
-		mouseX < win.width && mouseY < win.height &&
-		buttonPress == -1
-	) {
-		getMouseSelection(mouseX, mouseY);
-		removePlaneY = mouseRay[1];		// Set plane for moving blocks
-		if ( phase == PHASE_CHOOSE )
-			objectIndex = int(stencilIndex)-2;
+	if ( readbackPicking && ( phase == PHASE_CHOOSE || phase == PHASE_SELECT ) && mouseInWindow() && buttonPress == -1 ) {
+		GLdouble point[3];
+		getMouseSelection(mouseX, mouseY, point);
+		int pickedIndex = physWorld.findObjectAt(point, boxTrans);	// Identify block by the point under the cursor
+		physThread.setPicked(pickedIndex, btVector3(point[0], point[1], point[2]));
 	}
 
+	profiler.mark(STAGE_PICKING);
+
 	/* Draw line boxes for block edges */
 
-	for ( int i=0; i<BLOCK_NO; i++ ) {
-		glPushMatrix();
-			glTranslatef(
-				boxTrans[i].getOrigin().getX(),
-				boxTrans[i].getOrigin().getY(),
-				boxTrans[i].getOrigin().getZ()
-			);
-			glRotatef(
-				boxRotate[i].getAngle()/PI*180,
-				boxRotate[i].getAxis().getX(),
-				boxRotate[i].getAxis().getY(),
-				boxRotate[i].getAxis().getZ()
-			);
-			glColor3f(0,0,0);
-			drawLineBox(
-				physWorld.getBoxExtents().getX()+0.005,
-				physWorld.getBoxExtents().getY()+0.005,
-				physWorld.getBoxExtents().getZ()+0.005
-			);
-		glPopMatrix();
-	}
+	glColor3f(0,0,0);
+	renderer.drawEdges(boxExtents+btVector3(0.005,0.005,0.005));
 
 	/* Draw highlight box around selected block */
 
-	if ( ( phase == PHASE_CHOOSE && objectIndex >= 0 ) ||
-		phase == PHASE_REMOVE || phase == PHASE_SELECT || phase == PHASE_RAISE || phase == PHASE_PLACE
+	if ( objectIndex >= 0 && (
+		phase == PHASE_CHOOSE || phase == PHASE_REMOVE || phase == PHASE_SELECT || phase == PHASE_RAISE || phase == PHASE_PLACE )
 	) {
-		glPushMatrix();
-			glTranslatef(
-				boxTrans[objectIndex].getOrigin().getX(),
-				boxTrans[objectIndex].getOrigin().getY(),
-				boxTrans[objectIndex].getOrigin().getZ()
-			);
-			glRotatef(
-				boxRotate[objectIndex].getAngle()/PI*180,
-				boxRotate[objectIndex].getAxis().getX(),
-				boxRotate[objectIndex].getAxis().getY(),
-				boxRotate[objectIndex].getAxis().getZ()
-			);
-
-			GLdouble extra = 0.0;	// For extension of highlight box
-
-			if ( phase == PHASE_PLACE && boxRotate[objectIndex].getAxis().getX() < 1 && boxRotate[objectIndex].getAxis().getZ() < 1 )  {
-				// Extend box in y direction
-				extra = physWorld.getBoxExtents().getY()*3;
-				glTranslatef(0,-physWorld.getBoxExtents().getY()*3,0);
-			}
-			// Draw line box
-			if ( phase == PHASE_CHOOSE )
-				glColor3f(1,0,0);
-			else
-				glColor3f(0,1,0);
-			drawLineBox(
-				physWorld.getBoxExtents().getX()+0.015,
-				physWorld.getBoxExtents().getY()+0.015+extra,
-				physWorld.getBoxExtents().getZ()+0.015
-			);
-			// Draw transparent box
-			if ( phase == PHASE_CHOOSE )
-				glColor4f(1,0,0,0.4);
-			else
-				glColor4f(0,1,0,0.4);
-			drawBox(
-				physWorld.getBoxExtents().getX()+0.015,
-				physWorld.getBoxExtents().getY()+0.015+extra,
-				physWorld.getBoxExtents().getZ()+0.015
-			);
-		glPopMatrix();
-	}
-
-	/* Draw text and plane overlay features */
-
-	// Temporarily disable lighting and depth testing
-	glDisable(GL_LIGHTING);
-	glDepthFunc(GL_ALWAYS);
-
-	// Set default overlay colouring
-	glColor3f(1,1,1);
-
-	if ( phase != PHASE_COLLAPSE ) {
-		// Display Hi-Score and Score
-		char hiScore[14];
-		int slength = sprintf(hiScore, "Hi-Score: %d", maxTurnNo);
-		textOverlay(hiScore, slength, 14, win.height-24);
-		char score[11];
-		slength = sprintf(score, "Score: %d", int(std::min(turnNo, turnNo+BLOCK_NO-54)));
-		textOverlay(score, slength, 14, win.height-48);
-		if ( helpOn ) {
-			// Display empty help bar
-			textOverlay("H: Toggle help", 14, 5, 56, GLUT_BITMAP_HELVETICA_12);
-			glColor4f(1,1,1,0.5);
-			planeOverlay(0, 0, win.width, 50);
+		btTransform highlightTrans = boxTrans[objectIndex];
+		btVector3 highlightExtents = boxExtents+btVector3(0.015,0.015,0.015);
+
+		btVector3 axis = highlightTrans.getRotation().getAxis();
+		if ( phase == PHASE_PLACE && axis.getX() < 1 && axis.getZ() < 1 )  {
+			// Extend box in y direction
+			GLdouble extra = boxExtents.getY()*3;
+			highlightTrans.setOrigin(highlightTrans*btVector3(0,-extra,0));
+			highlightExtents += btVector3(0,extra,0);
 		}
+		// Draw line box
+		if ( phase == PHASE_CHOOSE )
+			glColor3f(1,0,0);
 		else
-			textOverlay("H: Toggle help", 14, 5, 5, GLUT_BITMAP_HELVETICA_12);
+			glColor3f(0,1,0);
+		renderer.drawLineBox(highlightTrans, highlightExtents);
+		// Draw transparent box
+		if ( phase == PHASE_CHOOSE )
+			glColor4f(1,0,0,0.4);
+		else
+			glColor4f(0,1,0,0.4);
+		renderer.drawBox(highlightTrans, highlightExtents);
 	}
 
-	if ( phase == PHASE_CHOOSE ) {
-		if ( drawCount > 0 ) {
-			// Display message during draw countdown
-			glColor3f(1,1,1);
-			textOverlay("Okay!", 5, win.width/2-25, win.height/2);
-			drawCount--;
-		}
-		if ( helpOn ) {
-			// Display help text for current phase
-			glColor3f(0,0,0);
-			textOverlay("Choose a block", 14, 10, 30);
-			textOverlay("W: push block; S: pull block; E: rotate camera; Space: choose block", 67, 10, 10, GLUT_BITMAP_HELVETICA_12);
-		}
-	}
-	else if ( phase == PHASE_REMOVE ) {
-		if ( helpOn ) {
-			glColor3f(0,0,0);
-			textOverlay("Remove block", 12, 10, 30);
-			textOverlay("W: raise block (when removed); A/D: rotate block; Release mouse to drop block", 77, 10, 10, GLUT_BITMAP_HELVETICA_12);
-		}
-	}
-	else if ( phase == PHASE_SELECT ) {
-		if ( drawCount > 0 ) {
-			glColor3f(1,1,1);
-			textOverlay("Try again", 9, win.width/2-40, win.height/2);
-			drawCount--;
-		}
-		if ( helpOn ) {
-			glColor3f(0,0,0);
-			textOverlay("Select block", 12, 10, 30);
-			textOverlay("W: push block; S: pull block; E: rotate camera; Space: check placement; Use the mouse to select the block", 105, 10, 10, GLUT_BITMAP_HELVETICA_12);
-		}
-	}
-	else if ( phase == PHASE_PLACE ) {
-		if ( helpOn ) {
-			glColor3f(0,0,0);
-			textOverlay("Place block", 11, 10, 30);
-			textOverlay("W: raise block; S: lower block; A/D: rotate block; E: rotate camera; Release mouse to drop block", 96, 10, 10, GLUT_BITMAP_HELVETICA_12);
-		}
-	}
-	else if ( phase == PHASE_CHECK ) {
-		glColor3f(1,1,1);
-		textOverlay("Checking...", 11, win.width/2-40, win.height/2);
-	}
-	else if ( phase == PHASE_COLLAPSE ) {
-		// Display 'GAME OVER' overlay
-		glColor4f(1,1,1,0.5);
-		planeOverlay(win.width/2-120, win.height/2-50, win.width/2+120, win.height/2+80);
-
-		glColor3f(0,0,0);
-		textOverlay("GAME OVER", 9, win.width/2-55, win.height/2+48);
-
-		char score[17];
-		int slength = sprintf(score, "Final score: %d", int(std::min(turnNo, turnNo+BLOCK_NO-54)));
-		if ( turnNo > maxTurnNo )
-			glColor3f(0.8,0,0);
-		textOverlay(score, slength, win.width/2-55, win.height/2+12);
-		if ( turnNo > maxTurnNo )
-			glColor3f(0,0,0);
-
-		if ( drawCount == 0 )
-			textOverlay("Press space to play again", 25, win.width/2-105, win.height/2-24);
-		else
-			drawCount--;
+	profiler.mark(STAGE_EDGES);
+
+	/* Draw text and plane overlay features */
+
+	// Rebuild the overlay only when something it shows has changed - stage timings twice a second
+	if ( profileOn )
+		profiler.summarize(0.5);
+	static int overlayState[6] = { -1, -1, -1, -1, -1, -1 };
+	int currentState[6] = { phase, helpOn, game->turnNo, game->maxTurnNo, game->messageTime > 0, profileOn ? profiler.getRevision() : -1 };
+	if ( !std::equal(currentState, currentState+6, overlayState) ) {
+		std::copy(currentState, currentState+6, overlayState);
+		buildOverlay();
 	}
+	overlay.draw(win.width, win.height);
 
-	// Re-enable lighting and depth testing
-	glEnable(GL_LIGHTING);
-	glDepthFunc(GL_LEQUAL);
+	profiler.mark(STAGE_OVERLAY);
 
 	/***** END OF DRAWING *****/
-	/* (Non-graphics related operations follow) */
+	/* (Camera movement follows - the game itself is ticked by the physics thread) */
 
 	/* If tower is currently collapsing, adjust camera to circle tower */
 
@@ -760,99 +400,99 @@ void display()
 			cam.adjustAngleX(0.5);
 	}
 
-	/* Check if tower has fallen in any minor way */
-
-	if ( ( !towerStanding || blockFallen ) && phase != PHASE_COLLAPSE )
-			setPhase(&phase, PHASE_COLLAPSE, 200);
-
-	/* If currently moving block, affect physics world block appropriately */
-
-	if ( buttonPress == GLUT_LEFT_BUTTON ) {
-		if ( phase == PHASE_REMOVE || phase == PHASE_PLACE ) {
-			// Move block horizontally to cursor
-			physWorld.dragObject(objectIndex, mouseRay, objectSelect);
-		}
-		else if ( phase == PHASE_RAISE ) {
-			// Raise block to top of tower
-			physWorld.raiseObjectTo(objectIndex, towerHeight+5.0);
-		}
-	}
-
 	/* Check if camera height needs adjusting */
 
 	if ( ( phase == PHASE_CHOOSE || phase == PHASE_SELECT ) && mouseY != -1 ) {
 		// Shift camera up or down
 		if ( mouseY < win.height/5 )
-			cam.adjustHeight(std::min(0.3,double(win.height/5-mouseY)/500.0), 0, towerHeight);
+			cam.adjustHeight(std::min(0.3,double(win.height/5-mouseY)/500.0), 0, game->towerHeight);
 		else if ( mouseY > win.height*4/5 )
-			cam.adjustHeight(std::max(-0.3,double(win.height*4/5-mouseY)/500.0), 0, towerHeight);
+			cam.adjustHeight(std::max(-0.3,double(win.height*4/5-mouseY)/500.0), 0, game->towerHeight);
 	}
 
-	/* If turning camera while placing, keep the selected block still */
+	profiler.mark(STAGE_LOGIC);
+	frameDrawCalls = renderer.takeDrawCalls();
+	renderTime = renderTime*0.9f + std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now()-frameStart).count()*0.1f;
 
-	if ( phase == PHASE_PLACE ) {
-		if ( cam.getAngleX() != cam.getActualAngleX() ) {
-			objectSelect[0] = mouseRay[0]-boxOrigin.getX();
-			objectSelect[2] = mouseRay[2]-boxOrigin.getZ();
-		}
-		else {
-			if ( ( objectSelect[0] > 0 && objectSelect[0] > mouseRay[0]-boxOrigin.getX() ) ||
-				( objectSelect[0] < 0 && objectSelect[0] < mouseRay[0]-boxOrigin.getX() )
-			)
-				objectSelect[0] = mouseRay[0]-boxOrigin.getX();
-			if ( ( objectSelect[2] > 0 && objectSelect[2] > mouseRay[2]-boxOrigin.getZ() ) ||
-				( objectSelect[2] < 0 && objectSelect[2] < mouseRay[2]-boxOrigin.getZ() )
-			)
-				objectSelect[2] = mouseRay[2]-boxOrigin.getZ();
-		}
-	}
+	/* Change buffers to display new frame */
 
-	/* If block has been placed, try to validate placement */
+#ifndef HEADLESS
+	glutSwapBuffers();
+#endif
+	profiler.mark(STAGE_SWAP);
+	profiler.endFrame();
+}
 
-	if ( phase == PHASE_CHECK ) {
-		if ( drawCount > 0 )
-			drawCount--;	// Minimum waiting time for checking
-		else {
-			if ( boxTrans[objectIndex].getOrigin().getY() < towerHeight-3.04 )
-				setPhase(&phase, PHASE_SELECT, 100);	// Invalid - block is too low
-			else {
-				// Check if the tower is moving
-				boolean towerActive = false;
-				for ( int i=0; i<BLOCK_NO; i++ ) {
-					if ( physWorld.isActive(i) ) {
-						towerActive = true;
-						break;
-					}
-				}
-
-				if ( !towerActive ) {
-					if ( boxTrans[objectIndex].getOrigin().getY() > towerHeight+1.52 )
-						setPhase(&phase, PHASE_SELECT, 100);	// Invalid - block is too high
-					else {
-						// Valid - go onto next turn
-						setPhase(&phase, PHASE_CHOOSE, 100);
-						turnNo++;
-						if ( (turnNo+BLOCK_NO)%3 == 0 )
-							towerHeight += 1.52;
-					}
-				}
-			}
+
+boolean sceneChanging()
+{
+	/* Check whether anything on screen may change without further input */
+
+	return physFrame->check.active ||			// Blocks are moving
+		!physThread.isCurrent(*physFrame) ||	// A reset has not gone through yet
+		cam.isMoving() ||
+		game->phase != shownPhase ||			// The camera has yet to follow the game
+		game->messageTime > 0 ||				// A message is counting down
+		buttonPress != -1 ||					// A block may be held
+		game->phase == PHASE_CHECK;				// Waiting for the tower to settle
+}
+
+
+void tick(int value)
+{
+	/* Draw a frame if one is due and the scene may have changed, then wait for the next */
+
+	static boolean idleSecond = true;	// Whether nothing on screen could change all through this second
+	boolean changing = sceneChanging();
+	if ( changing )
+		idleSecond = false;
+	if ( scheduler.shouldDraw(changing) )
+		glutPostRedisplay();
+
+	// Report timing once a second, including while frames are being skipped
+	static std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	static std::chrono::steady_clock::time_point lastReport = runStart;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if ( now-lastReport >= std::chrono::seconds(1) ) {
+		char title[160];
+		sprintf(title, "%s - %d fps, render %.1f ms (%d draws), physics %.2f ms (%.0f ticks/s), cpu %.0f%%",
+			win.title, scheduler.getFramesDrawn(), renderTime, frameDrawCalls,
+			physFrame->stepTime, physFrame->tickRate, scheduler.getCpuUsage());
+		glutSetWindowTitle(title);
+		scheduler.measure();
+		lastReport = now;
+
+		// Idle usage, to compare the scheduler's settings - for example against --always-draw --fps 0
+		if ( idleSecond ) {
+			idleCpuSum += scheduler.getCpuUsage();
+			idleSecondNo++;
+		}
+		idleSecond = true;
+		if ( idleReportTime > 0 && std::chrono::duration<double>(now-runStart).count() >= idleReportTime ) {
+			if ( idleSecondNo > 0 )
+				printf("Idle CPU: %.1f%% of a core, over %d idle seconds\n", idleCpuSum/idleSecondNo, idleSecondNo);
+			else
+				printf("Idle CPU: no idle seconds in %.0f s\n", idleReportTime);
+			exit(0);		// GLUT only leaves its main loop through exit()
 		}
 	}
 
-	/* Change buffers to display new frame */
-
-	glutSwapBuffers();
+	glutTimerFunc(scheduler.getDelay(), tick, 0);
 }
 
 
 void initialize()
 {
+	GLenum glewStatus = glewInit();		// Load buffer, shader and instancing entry points
+	if ( glewStatus != GLEW_OK ) {
+		fprintf(stderr, "Could not load OpenGL extensions: %s\n", (const char*) glewGetErrorString(glewStatus));
+		exit(1);
+	}
+
 	glViewport(0, 0, win.width, win.height);	// Set viewport
 	glMatrixMode(GL_PROJECTION);	// Select projection matrix
-	glLoadIdentity();				// Reset projection matrix
-	GLfloat aspect = (float) win.width / win.height;
-	gluPerspective(win.field_of_view_angle, aspect, win.z_near, win.z_far);		// Set up projection matrix
+	cam.setPerspective(win.field_of_view_angle, win.width, win.height, win.z_near, win.z_far);
+	glLoadMatrixd(cam.getProjection());		// Set up projection matrix, as kept by the camera
 
 	glMatrixMode(GL_MODELVIEW);		// Select model view matrix
 
@@ -882,80 +522,46 @@ void initialize()
 	glDepthFunc(GL_LEQUAL);
 	glEnable(GL_DEPTH_TEST);
 
-	/* Enable stencil testing */
-
-	glClearStencil(0);
-	glEnable(GL_STENCIL_TEST);
-
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
 	/* Enable line drawing options */
 
 	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_BLEND);
 	glEnable(GL_LINE_SMOOTH);
+
+	renderer.initialize();
+#ifndef HEADLESS
+	overlay.initialize(win.width, win.height);		// Glyphs come from GLUT, which needs a window
+#endif
 }
 
 
 void keyboard(unsigned char key, int mouseX, int mouseY)
 {
+	scheduler.markDirty();
+
 	switch (key)
 	{
 	case KEY_Esc:
 		exit(0);	// Exit game
 		break;
 	case KEY_SPACE:
-		if ( phase == PHASE_CHOOSE && objectIndex >= 0 &&
-			boxTrans[std::max(0,objectIndex)].getOrigin().getY() < towerHeight-1.52
-		)
-			// Choose block
-			setPhase(&phase, PHASE_SELECT);
-		else if ( phase == PHASE_SELECT )
-			// Check a block placement
-			setPhase(&phase, PHASE_CHECK, 50);
-		else if ( phase == PHASE_COLLAPSE && drawCount == 0 ) {
-			// Reset the game
-			if ( turnNo > maxTurnNo )
-				maxTurnNo = turnNo;
-			resetGame();
-		}
-		break;
-	case KEY_w: // W corresponds to up
-		if ( ( phase == PHASE_CHOOSE && objectIndex >= 0 &&
-			boxTrans[std::max(0,objectIndex)].getOrigin().getY() < towerHeight-1.52 ) ||
-			( phase == PHASE_SELECT && objectIndex+2 == stencilIndex )
-		)
-			physWorld.pushObject(objectIndex, -15, mouseRay);
-		else if ( phase == PHASE_REMOVE && !physWorld.checkContact(objectIndex) )
-			setPhase(&phase, PHASE_RAISE);
-		else if ( phase == PHASE_PLACE && objectSelect[1] > -1.52 )
-			objectSelect[1] -= 0.76;	// Raise block
-		break;
-	case KEY_s: // S corresponds to down
-		if ( ( phase == PHASE_CHOOSE && objectIndex >= 0 &&
-			boxTrans[std::max(0,objectIndex)].getOrigin().getY() < towerHeight-1.52 ) ||
-			( phase == PHASE_SELECT && objectIndex+2 == stencilIndex )
-		)
-			physWorld.pushObject(objectIndex, 15, mouseRay);
-		else if ( phase == PHASE_PLACE && objectSelect[1] <= 3.24 )
-			objectSelect[1] += 0.76;	// Lower block
-		break;
-	case KEY_a: // A corresponds to left
-		if ( phase == PHASE_REMOVE || phase == PHASE_PLACE )
-			physWorld.turnObject(objectIndex, 25);		// Rotate block anti-clockwise
-		break;
-	case KEY_d: // D corresponds to right
-		if ( phase == PHASE_REMOVE || phase == PHASE_PLACE )
-			physWorld.turnObject(objectIndex, -25);		// Rotate block clockwise
+	case KEY_w:		// W corresponds to up
+	case KEY_s:		// S corresponds to down
+	case KEY_a:		// A corresponds to left
+	case KEY_d:		// D corresponds to right
+		physThread.postGameEvent(GAME_KEY, key);	// Played on the game's next tick
 		break;
 	case KEY_e:
-		if ( phase == PHASE_CHOOSE || phase == PHASE_SELECT || phase == PHASE_PLACE )
+		if ( game->phase == PHASE_CHOOSE || game->phase == PHASE_SELECT || game->phase == PHASE_PLACE )
 			cam.adjustAngleX(45);		// Rotate camera around tower
 		break;
 	case KEY_h:
-		if ( phase != PHASE_COLLAPSE )
+		if ( game->phase != PHASE_COLLAPSE )
 			helpOn = !helpOn;	// Turn on help option
 		break;
+	case KEY_t:
+		profileOn = !profileOn;		// Show frame stage timings
+		break;
 	default:
 		break;
 	}
@@ -964,21 +570,16 @@ void keyboard(unsigned char key, int mouseX, int mouseY)
 
 void mouse(int button, int state, int x, int y)
 {
+	scheduler.markDirty();
+
 	switch (button)
 	{
 	case GLUT_LEFT_BUTTON:
-		if ( state == GLUT_DOWN ) {
-			// Select block
-			if ( phase == PHASE_SELECT && objectIndex+2 == stencilIndex && removePlaneY < cam.getEyeY()-3 )
-				setPhase(&phase, PHASE_REMOVE);
-		}
-		else if ( state == GLUT_UP ) {
-			// Release block
-			if ( phase == PHASE_REMOVE || phase == PHASE_RAISE || phase == PHASE_PLACE ) {
-				setPhase(&phase, PHASE_SELECT);
-				physWorld.stopObject(objectIndex);
-			}
-		}
+		// Select or release block, on the game's next tick
+		if ( state == GLUT_DOWN )
+			physThread.postGameEvent(GAME_PRESS, 0);
+		else if ( state == GLUT_UP )
+			physThread.postGameEvent(GAME_RELEASE, 0);
 		break;
 
 	default:
@@ -1000,6 +601,8 @@ void motion(int x, int y)
 
 	mouseX = x;
 	mouseY = y;
+	sendPointer();
+	scheduler.markDirty();
 }
 
 
@@ -1009,7 +612,78 @@ void passive(int x, int y)
 
 	mouseX = x;
 	mouseY = y;
+	sendPointer();
+	scheduler.markDirty();
+}
+
+
+#ifdef HEADLESS
+int runHeadless(HeadlessBackend& backend, const char* scriptPath, int frameNo, const char* dumpPattern, const char* timingPath)
+{
+	/* Draw frames off-screen with scripted input, then report how long each took */
+
+	// Script lines are "frame type values", with types:
+	//   key c | move x y | drag x y | press x y | release x y | camera angleX angleY distance height
+	std::vector<ScriptEvent> events;
+	if ( scriptPath && !backend.loadScript(scriptPath, events) ) {
+		fprintf(stderr, "Could not read script %s\n", scriptPath);
+		return 1;
+	}
+
+	size_t nextEvent = 0;
+	for ( int frame = 0; frame < frameNo; frame++ ) {
+		// Apply input due by this frame through the usual handlers
+		for ( ; nextEvent < events.size() && events[nextEvent].frame <= frame; nextEvent++ ) {
+			const ScriptEvent& event = events[nextEvent];
+			int x = int(event.values[0]);
+			int y = int(event.values[1]);
+			if ( event.type == "key" )
+				keyboard((unsigned char) event.values[0], mouseX, mouseY);
+			else if ( event.type == "move" )
+				passive(x, y);
+			else if ( event.type == "drag" )
+				motion(x, y);
+			else if ( event.type == "press" ) {
+				passive(x, y);
+				mouse(GLUT_LEFT_BUTTON, GLUT_DOWN, x, y);
+			}
+			else if ( event.type == "release" )
+				mouse(GLUT_LEFT_BUTTON, GLUT_UP, x, y);
+			else if ( event.type == "camera" ) {
+				cam.setAngleX(event.values[0]);
+				cam.setAngleY(event.values[1]);
+				cam.setDistance(event.values[2]);
+				cam.setHeight(event.values[3]);
+			}
+			else
+				fprintf(stderr, "Unknown script event '%s' on frame %d\n", event.type.c_str(), event.frame);
+		}
+
+		// Advance game time by the same amount every frame, so runs are repeatable
+		physThread.tick(HEADLESS_FRAME_TICKS);
+
+		backend.beginFrame();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		display();
+		backend.endFrame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count(),
+			profiler.getStage(STAGE_PICKING), profiler.getStage(STAGE_PHYSICS));
+
+		if ( dumpPattern ) {
+			char path[256];
+			snprintf(path, sizeof(path), dumpPattern, frame);
+			if ( !backend.saveFrame(path) )
+				fprintf(stderr, "Could not write frame to %s\n", path);
+		}
+	}
+
+	backend.printSummary();
+	if ( timingPath && !backend.saveTimings(timingPath) ) {
+		fprintf(stderr, "Could not write timings to %s\n", timingPath);
+		return 1;
+	}
+	return 0;
 }
+#endif
 
 
 int main(int argc, char **argv)
@@ -1027,22 +701,118 @@ int main(int argc, char **argv)
 
 	/* Initialize and run program */
 
+#ifndef HEADLESS
 	glutInit(&argc, argv);
-	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH | GLUT_STENCIL);
+#else
+	const char* scriptPath = 0;		// Input to feed in, if any
+	int frameNo = 600;
+	const char* dumpPattern = 0;	// printf pattern for frame image files, given the frame number
+	const char* timingPath = 0;		// CSV of frame times
+	bool timerQueries = true;		// Whether to time frames on the GL side too
+#endif
+
+	// Read settings from any arguments left over by GLUT
+	int blockNo = BLOCK_NO;
+	int layerWidth = LAYER_WIDTH;
+	int physicsThreadNo = 0;	// Threads for Bullet's multithreaded pipeline within the physics thread (0 for serial)
+	boolean vsync = false;
+	for ( int i=1; i<argc; i++ ) {
+		if ( !strcmp(argv[i], "--blocks") && i+1 < argc )
+			blockNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--width") && i+1 < argc )
+			layerWidth = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--physics-threads") && i+1 < argc )
+			physicsThreadNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--record") && i+1 < argc )
+			recordPath = argv[++i];
+		else if ( !strcmp(argv[i], "--readback-picking") )
+			readbackPicking = true;
+		else if ( !strcmp(argv[i], "--fps") && i+1 < argc )
+			scheduler.setTargetFps(atof(argv[++i]));	// 0 for no cap
+		else if ( !strcmp(argv[i], "--vsync") )
+			vsync = true;
+		else if ( !strcmp(argv[i], "--always-draw") )
+			scheduler.setDirtyOnly(false);	// Draw every frame, as a baseline for comparison
+		else if ( !strcmp(argv[i], "--idle-cpu") && i+1 < argc )
+			idleReportTime = atof(argv[++i]);
+		else if ( !strcmp(argv[i], "--profile") && i+1 < argc ) {
+			if ( !profiler.openCsv(argv[++i]) )
+				fprintf(stderr, "Could not open %s for frame timings\n", argv[i]);
+		}
+#ifdef HEADLESS
+		else if ( !strcmp(argv[i], "--script") && i+1 < argc )
+			scriptPath = argv[++i];
+		else if ( !strcmp(argv[i], "--frames") && i+1 < argc )
+			frameNo = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "--dump") && i+1 < argc )
+			dumpPattern = argv[++i];
+		else if ( !strcmp(argv[i], "--timings") && i+1 < argc )
+			timingPath = argv[++i];
+		else if ( !strcmp(argv[i], "--no-timer-query") )
+			timerQueries = false;
+#endif
+		else {
+			fprintf(stderr, "Usage: %s [--blocks N] [--width W] [--physics-threads T] [--record FILE] [--readback-picking] "
+				"[--fps N] [--vsync] [--always-draw] [--idle-cpu SECONDS] [--profile FILE]"
+#ifdef HEADLESS
+				" [--script FILE] [--frames N] [--dump PATTERN] [--timings FILE] [--no-timer-query]"
+#endif
+				"\n", argv[0]);
+			fprintf(stderr, "Physics always steps on its own thread - --physics-threads runs Bullet's multithreaded pipeline on T threads there\n");
+			return 1;
+		}
+	}
+
+#ifdef HEADLESS
+	// Render into memory on Mesa, which needs GLEW built with GLEW_OSMESA to find its entry points
+	HeadlessBackend backend;
+	if ( !backend.create(win.width, win.height) ) {
+		fprintf(stderr, "Could not create an off-screen GL context\n");
+		return 1;
+	}
+	backend.setTimerQueries(timerQueries);
+	physThread.setLockstep(true);
+#else
+	glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
 	glutInitWindowSize(win.width,win.height);
 	glutCreateWindow(win.title);
 
 	glutDisplayFunc(display);			// Register display function
-	glutIdleFunc(display);				// Register idle function
+	glutTimerFunc(0, tick, 0);			// Start frame scheduling
 	glutKeyboardFunc(keyboard);			// Register keyboard handler
 	glutMouseFunc(mouse);				// Register mouse handler
 	glutMotionFunc(motion);				// Register mouse motion handler
 	glutPassiveMotionFunc(passive);		// Register passive mouse motion handler
+#endif
 
 	initialize();
+	if ( vsync && !scheduler.requestVsync(true) )
+		fprintf(stderr, "Vsync is not available, relying on the frame rate cap\n");
+	physWorld.setStepRate(STEP_RATE);
+	physWorld.setTowerSize(blockNo, layerWidth);
+	if ( physicsThreadNo > 0 && setPhysicsThreads(physicsThreadNo) )
+		physWorld.setThreading(true, true);
 	physWorld.createWorld();
+	renderer.buildFloor(physWorld.getSurfaceHeight(), H_SPAN, win.z_far/2);
+	if ( recordPath ) {
+		physWorld.startRecording(&inputLog);
+		atexit(saveRecording);		// GLUT only leaves its main loop through exit()
+	}
 
+	session.start(&physWorld);
+	physThread.setSession(&session);
+	physThread.start(&physWorld, STEP_RATE);
+	physFrame = &physThread.acquireFrame();
+	boxTrans = physFrame->trans.data();
+	game = &physFrame->game;
+
+#ifdef HEADLESS
+	int status = runHeadless(backend, scriptPath, frameNo, dumpPattern, timingPath);
+	physThread.stop();		// Before the context and world go
+	return status;
+#else
 	glutMainLoop();		// Start draw loop
 
 	return 0;
+#endif
 }